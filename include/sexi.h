@@ -28,7 +28,160 @@ typedef struct SexiParseResultT *SexiParseResult;
 SexiParseResult sexiParse(size_t len, const char *ptr, bool copyStrs);
 
 /**
- * @brief Destroy a parse result created by \ref sexiParse .
+ * @brief Options controlling how \ref sexiParseEx parses.
+ */
+typedef struct {
+	/**
+	 * @brief Whether to make copies of refed strings.
+	 */
+	bool copyStrs;
+
+	/**
+	 * @brief Maximum list nesting depth, or 0 for no limit.
+	 * Exceeding the limit is reported as a parse error.
+	 */
+	size_t maxDepth;
+
+	/**
+	 * @brief Number of threads to parse with, 0 or 1 to parse on the calling thread.
+	 * Large sources are split between top-level expressions and the pieces are
+	 * parsed concurrently; the expressions of the result stay in source order.
+	 * The threads are started by the first such parse and kept for later ones.
+	 */
+	size_t numThreads;
+
+	/**
+	 * @brief Table to intern ids into, or `NULL` .
+	 * Every id then references the table's copy of its string, whatever
+	 * `copyStrs` says, and has a symbol; see \ref sexiExprSymbol . The table
+	 * must outlive the result and may be shared by parses on several threads.
+	 */
+	SexiSymbolTable symbols;
+
+	/**
+	 * @brief Pool to build the expressions in, or `NULL` .
+	 * Identical subtrees then share one expression owned by the pool, see
+	 * \ref SexiExprPool , whatever `copyStrs` says. The pool must outlive the
+	 * result and is locked for the whole parse, so `numThreads` is ignored.
+	 */
+	SexiExprPool pool;
+
+	/**
+	 * @brief Allocator for the memory of the result, or `NULL` for the default.
+	 * Expressions, copied strings and the result itself all come from it, and
+	 * go back to it when the result is destroyed; see \ref SexiAllocator .
+	 * It must stay valid until then.
+	 */
+	const SexiAllocator *allocator;
+
+	/**
+	 * @brief Whether to record where in the source each expression was found.
+	 * Spans are kept in a compact table next to the expressions, see
+	 * \ref sexiParseResultSpan . Ignored when parsing into a `pool` .
+	 */
+	bool locations;
+
+	/**
+	 * @brief Whether to keep parsing after an error in the source.
+	 * The rest of a top-level expression containing an error is skipped up
+	 * to its closing paren, and stray tokens between expressions up to the
+	 * next opening paren. Every error is kept, see \ref sexiParseResultErrors ,
+	 * and the result has the expressions parsed around them.
+	 */
+	bool recover;
+
+	/**
+	 * @brief Nesting depth from which lists are only built when first accessed, or 0 to build everything.
+	 * 1 leaves every top-level list unbuilt, 2 builds those but not the lists
+	 * in them, and so on. The source is still checked for errors as a whole,
+	 * an unbuilt list only keeps its source text, which must then outlive the
+	 * result unless `copyStrs` is set. \ref sexiExprLength , \ref sexiExprAt
+	 * and anything else reading the elements of such a list builds it with
+	 * everything in it, once, which is safe to do from several threads at once.
+	 * Expressions in lists built that way have no span, see `locations` .
+	 * If there's no memory to build a list with it's left unbuilt for the next access
+	 * to try again, reads of it fail meanwhile and the result reports the error.
+	 * Ignored when parsing into a `pool` .
+	 */
+	size_t lazyDepth;
+} SexiParseOptions;
+
+/**
+ * @brief Parse s-expressions from a string with extra options.
+ * @param len length of the string
+ * @param ptr pointer to the string
+ * @param opts parsing options or `NULL` to behave like \ref sexiParse with `copyStrs` set
+ * @returns newly created parse result
+ * @see sexiDestroyParseResult
+ */
+SexiParseResult sexiParseEx(size_t len, const char *ptr, const SexiParseOptions *opts);
+
+/**
+ * @brief Parse s-expressions from a file.
+ * The file is memory-mapped read-only and kept mapped by the result, so ids,
+ * strings and numbers reference the mapping directly and `copyStrs` is ignored.
+ * @param path path of the file to parse
+ * @param opts parsing options or `NULL` for the defaults
+ * @returns newly created parse result, containing an error if the file couldn't be read
+ * @see sexiDestroyParseResult
+ */
+SexiParseResult sexiParseFile(const char *path, const SexiParseOptions *opts);
+
+/**
+ * @brief Callback receiving a single parse event.
+ * @param user user data passed to \ref sexiParseEvents
+ * @param str source text of the event: a paren, or a token exactly as written
+ * @param offset offset of \p str from the start of the source
+ * @returns whether to keep parsing
+ */
+typedef bool(*SexiParseEventFn)(void *user, SexiStr str, size_t offset);
+
+/**
+ * @brief Callbacks for \ref sexiParseEvents , any of which may be `NULL` .
+ */
+typedef struct {
+	/**
+	 * @brief Called at the opening paren of each list, including empty lists.
+	 */
+	SexiParseEventFn listBegin;
+
+	/**
+	 * @brief Called at the closing paren of each list.
+	 */
+	SexiParseEventFn listEnd;
+
+	/**
+	 * @brief Called for each id.
+	 */
+	SexiParseEventFn id;
+
+	/**
+	 * @brief Called for each string, \p str includes the quotes.
+	 */
+	SexiParseEventFn str;
+
+	/**
+	 * @brief Called for each number.
+	 */
+	SexiParseEventFn num;
+} SexiParseEvents;
+
+/**
+ * @brief Parse s-expressions from a string without building any expressions.
+ * Every list and token is reported to \p events in source order as it is
+ * found, and nothing is allocated. Events before an error in the source are
+ * still delivered.
+ * @param len length of the string
+ * @param ptr pointer to the string
+ * @param events callbacks to call
+ * @param user user data passed to every callback
+ * @param opts parsing options or `NULL` for the defaults, only `maxDepth` is used
+ * @returns error string or a `NULL` string of 0 length
+ */
+SexiStr sexiParseEvents(size_t len, const char *ptr, const SexiParseEvents *events, void *user, const SexiParseOptions *opts);
+
+/**
+ * @brief Destroy a parse result created by \ref sexiParse , \ref sexiParseEx , \ref sexiParseFile or \ref sexiDecodeBinary .
  * @param res result to destroy
  */
 void sexiDestroyParseResult(SexiParseResult res);
@@ -47,6 +200,70 @@ bool sexiParseResultHasError(SexiParseResult res);
  */
 SexiStr sexiParseResultError(SexiParseResult res);
 
+/**
+ * @brief Position in a source.
+ */
+typedef struct {
+	size_t offset; ///< offset in bytes from the start of the source
+	size_t line; ///< line, starting at 1
+	size_t column; ///< offset in bytes from the start of the line, starting at 1
+} SexiSourcePos;
+
+/**
+ * @brief Get where in the source the error of a parse result was found.
+ * Lines and columns are only worked out once a parse fails, so positions
+ * cost nothing otherwise.
+ * @param res result to query
+ * @param[out] pos set to the position of the character that caused the error
+ * @returns whether the result has an error with a known position
+ */
+bool sexiParseResultErrorPos(SexiParseResult res, SexiSourcePos *pos);
+
+/**
+ * @brief Error found in a source.
+ */
+typedef struct {
+	SexiStr msg; ///< what went wrong
+	SexiSourcePos pos; ///< where it went wrong
+} SexiParseErrorInfo;
+
+/**
+ * @brief Get the number of errors found in the source of a parse result.
+ * Without the `recover` option parsing stops at the first error, so there is
+ * at most one.
+ * @param res result to query
+ * @returns number of errors
+ */
+size_t sexiParseResultNumErrors(SexiParseResult res);
+
+/**
+ * @brief Get every error found in the source of a parse result, in source order.
+ * The first is the error of the result unless parsing ran out of memory.
+ * @param res result to query
+ * @returns pointer to the errors or `NULL`
+ */
+const SexiParseErrorInfo *sexiParseResultErrors(SexiParseResult res);
+
+/**
+ * @brief Part of a source.
+ */
+typedef struct {
+	size_t offset; ///< offset in bytes from the start of the source
+	size_t len; ///< length in bytes, including both parens of a list
+} SexiSourceSpan;
+
+/**
+ * @brief Get where in the source an expression of a parse result was found.
+ * Only results parsed with the `locations` option have spans. The first call
+ * indexes the expressions of the result, which is safe to do from several
+ * threads at once.
+ * @param res result to query
+ * @param expr expression of \p res , at any depth
+ * @param[out] span set to the source text of \p expr
+ * @returns whether the span of \p expr is known
+ */
+bool sexiParseResultSpan(SexiParseResult res, SexiExprConst expr, SexiSourceSpan *span);
+
 /**
  * @brief Get the number of expressions in a parse result.
  * @param res result to check
@@ -61,59 +278,221 @@ size_t sexiParseResultNumExprs(SexiParseResult res);
  */
 const SexiExprConst *sexiParseResultExprs(SexiParseResult res);
 
+/**
+ * @brief Opaque type representing a resumable parser.
+ */
+typedef struct SexiParserT *SexiParser;
+
+/**
+ * @brief Callback receiving every top-level expression completed by a \ref SexiParser .
+ * @param user user data passed to \ref sexiParserCreate
+ * @param expr the expression, only valid until the callback returns
+ */
+typedef void(*SexiParserFn)(void *user, SexiExprConst expr);
+
+/**
+ * @brief Create a parser for input that arrives in chunks.
+ * Only the current unfinished top-level expression is buffered, so memory use
+ * is bounded by the largest expression rather than the length of the stream.
+ * Expressions are handed to \p fn as soon as their closing paren is fed and
+ * reference the parser's buffer, so `copyStrs` is ignored; use \ref sexiCloneExpr
+ * to keep one, or parse into a `pool` whose expressions outlive the callback.
+ * @param opts parsing options or `NULL` for the defaults, `locations`, `recover` and `lazyDepth` are ignored
+ * @param fn function called with each completed top-level expression
+ * @param user user data passed to \p fn
+ * @returns newly created parser
+ * @see sexiParserDestroy
+ */
+SexiParser sexiParserCreate(const SexiParseOptions *opts, SexiParserFn fn, void *user);
+
+/**
+ * @brief Destroy a parser created by \ref sexiParserCreate .
+ * @param parser parser to destroy
+ */
+void sexiParserDestroy(SexiParser parser);
+
+/**
+ * @brief Feed the next chunk of input to a parser.
+ * Chunks may split the input anywhere, including inside ids, numbers and strings.
+ * Must not be called from the parser's own callback.
+ * @param parser parser to feed
+ * @param len length of the chunk
+ * @param ptr pointer to the chunk
+ * @returns whether the input is still valid, once an error occurs every call fails
+ */
+bool sexiParserFeed(SexiParser parser, size_t len, const char *ptr);
+
+/**
+ * @brief Signal the end of the input.
+ * On success the parser is ready to parse a new stream.
+ * @param parser parser to finish
+ * @returns whether the input ended between top-level expressions without error
+ */
+bool sexiParserFinish(SexiParser parser);
+
+/**
+ * @brief Check if a parser has encountered an error.
+ * @param parser parser to check
+ * @returns whether the parser has an error
+ */
+bool sexiParserHasError(SexiParser parser);
+
+/**
+ * @brief Get the error string from a parser.
+ * @param parser parser to query
+ * @returns error string or a `NULL` string of 0 length
+ */
+SexiStr sexiParserError(SexiParser parser);
+
 #ifdef __cplusplus
 }
 
 #include <vector>
+#include <string>
 #include <string_view>
+#include <functional>
 
 namespace sexi{
+	/**
+	 * @brief Owner of the expressions of a parse.
+	 * The expressions are handed out as \ref ExprRef , which stay valid as
+	 * long as the result does.
+	 */
 	class ParseResult{
 		public:
+			ParseResult(ParseResult &&other) noexcept
+				: m_res(other.m_res)
+			{
+				other.m_res = nullptr;
+			}
+
+			ParseResult(const ParseResult&) = delete;
+
 			~ParseResult(){
-				sexiDestroyParseResult(m_res);
+				if(m_res) sexiDestroyParseResult(m_res);
 			}
 
-			bool hasError() noexcept{ return sexiParseResultHasError(m_res); }
+			ParseResult &operator=(const ParseResult&) = delete;
 
-			std::string_view error() noexcept{
+			bool hasError() const noexcept{ return sexiParseResultHasError(m_res); }
+
+			std::string_view error() const noexcept{
 				auto str = sexiParseResultError(m_res);
 				return { str.ptr, str.len };
 			}
 
-			std::size_t size() const noexcept{ return m_exprs.size(); }
-			const Expr &operator[](std::size_t idx) const noexcept{ return m_exprs[idx]; }
+			/**
+			 * @see sexiParseResultErrorPos
+			 */
+			bool errorPos(SexiSourcePos &pos) const noexcept{ return sexiParseResultErrorPos(m_res, &pos); }
+
+			std::size_t numErrors() const noexcept{ return sexiParseResultNumErrors(m_res); }
+
+			/**
+			 * @see sexiParseResultErrors
+			 */
+			const SexiParseErrorInfo &errorInfo(std::size_t idx) const noexcept{ return sexiParseResultErrors(m_res)[idx]; }
 
-			SexiExprConst operator[](std::size_t idx) noexcept{ return sexiParseResultExprs(m_res)[idx]; }
+			/**
+			 * @see sexiParseResultSpan
+			 */
+			bool span(ExprRef expr, SexiSourceSpan &span) const noexcept{ return sexiParseResultSpan(m_res, expr, &span); }
 
-			auto begin() const noexcept{ return cbegin(m_exprs); }
-			auto end() const noexcept{ return cend(m_exprs); }
+			std::size_t size() const noexcept{ return sexiParseResultNumExprs(m_res); }
+			ExprRef operator[](std::size_t idx) const noexcept{ return sexiParseResultExprs(m_res)[idx]; }
 
-			const std::vector<Expr> &exprs() const noexcept{ return m_exprs; }
+			ExprSpan::Iter begin() const noexcept{ return exprs().begin(); }
+			ExprSpan::Iter end() const noexcept{ return exprs().end(); }
+
+			ExprSpan exprs() const noexcept{ return ExprSpan(sexiParseResultExprs(m_res), size()); }
 
 		private:
 			explicit ParseResult(SexiParseResult res_) noexcept
-				: m_res(res_)
-			{
-				auto n = sexiParseResultNumExprs(m_res);
-				auto p = sexiParseResultExprs(m_res);
-
-				m_exprs.reserve(n);
-				for(size_t i = 0; i < n; i++){
-					m_exprs.emplace_back(p[i]);
-				}
-			}
+				: m_res(res_){}
 
 			SexiParseResult m_res;
-			std::vector<Expr> m_exprs;
 
 			friend ParseResult parse(std::string_view, bool);
+			friend ParseResult parse(std::string_view, const SexiParseOptions&);
+			friend ParseResult parseFile(const std::string&, const SexiParseOptions*);
+			friend ParseResult decodeBinary(std::string_view, const SexiParseOptions*);
 	};
 
 	inline ParseResult parse(std::string_view src, bool copyStrs = true){
 		auto res = sexiParse(src.size(), src.data(), copyStrs);
 		return ParseResult(res);
 	}
+
+	inline ParseResult parse(std::string_view src, const SexiParseOptions &opts){
+		auto res = sexiParseEx(src.size(), src.data(), &opts);
+		return ParseResult(res);
+	}
+
+	inline ParseResult parseFile(const std::string &path, const SexiParseOptions *opts = nullptr){
+		auto res = sexiParseFile(path.c_str(), opts);
+		return ParseResult(res);
+	}
+
+	/**
+	 * @brief Parse s-expressions from a string, reporting each list and token to \p handler .
+	 * \p handler needs the members `listBegin(std::size_t offset)` , `listEnd(std::size_t offset)` ,
+	 * `id(std::string_view, std::size_t offset)` , `str(std::string_view, std::size_t offset)` and
+	 * `num(std::string_view, std::size_t offset)` , each returning whether to keep parsing.
+	 * @returns error string or an empty string
+	 * @see sexiParseEvents
+	 */
+	template<typename Handler>
+	std::string_view parseEvents(std::string_view src, Handler &handler, const SexiParseOptions *opts = nullptr){
+		SexiParseEvents events = {
+			.listBegin = [](void *user, SexiStr, size_t offset) -> bool{ return static_cast<Handler*>(user)->listBegin(offset); },
+			.listEnd = [](void *user, SexiStr, size_t offset) -> bool{ return static_cast<Handler*>(user)->listEnd(offset); },
+			.id = [](void *user, SexiStr str, size_t offset) -> bool{ return static_cast<Handler*>(user)->id(std::string_view(str.ptr, str.len), offset); },
+			.str = [](void *user, SexiStr str, size_t offset) -> bool{ return static_cast<Handler*>(user)->str(std::string_view(str.ptr, str.len), offset); },
+			.num = [](void *user, SexiStr str, size_t offset) -> bool{ return static_cast<Handler*>(user)->num(std::string_view(str.ptr, str.len), offset); },
+		};
+
+		auto err = sexiParseEvents(src.size(), src.data(), &events, &handler, opts);
+		return { err.ptr, err.len };
+	}
+
+	class Parser{
+		public:
+			/**
+			 * @brief Function called with each completed top-level expression.
+			 * The expression is only valid during the call.
+			 */
+			using Callback = std::function<void(ExprRef)>;
+
+			explicit Parser(Callback fn, const SexiParseOptions *opts = nullptr)
+				: m_fn(std::move(fn)), m_parser(sexiParserCreate(opts, emit, this)){}
+
+			Parser(const Parser&) = delete;
+
+			~Parser(){
+				sexiParserDestroy(m_parser);
+			}
+
+			Parser &operator=(const Parser&) = delete;
+
+			bool feed(std::string_view chunk){ return sexiParserFeed(m_parser, chunk.size(), chunk.data()); }
+			bool finish(){ return sexiParserFinish(m_parser); }
+
+			bool hasError() noexcept{ return sexiParserHasError(m_parser); }
+
+			std::string_view error() noexcept{
+				auto str = sexiParserError(m_parser);
+				return { str.ptr, str.len };
+			}
+
+		private:
+			static void emit(void *user, SexiExprConst expr){
+				auto self = static_cast<Parser*>(user);
+				self->m_fn(expr);
+			}
+
+			Callback m_fn;
+			SexiParser m_parser;
+	};
 }
 #endif // __cplusplus
 
@@ -0,0 +1,89 @@
+#ifndef SEXI_BINARY_H
+#define SEXI_BINARY_H 1
+
+#include "../sexi.h"
+
+/**
+ * @defgroup Binary Binary encoding
+ *
+ * A compact encoding of expressions that decodes in a single forward pass.
+ *
+ * Data starts with the 4 bytes `SXB` and a version byte of 1, followed by
+ * the top-level expressions. Every expression starts with a tag byte whose
+ * low 3 bits are a \ref SexiBinaryTag and whose high 5 bits hold a count up
+ * to 30; a count of 31 means the real count follows as an unsigned LEB128
+ * varint. The count is the number of elements of a list, the number of
+ * bytes of text following an id, string or number, or the value of an
+ * integer. Elements of a list directly follow it. Numbers are only stored
+ * by value when their text is exactly what their value prints as, so the
+ * text comes back unchanged.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Type tags of the binary encoding.
+ */
+typedef enum {
+	SEXI_BINARY_EMPTY = 0,
+	SEXI_BINARY_LIST = 1,
+	SEXI_BINARY_ID = 2,
+	SEXI_BINARY_STR = 3, // text includes the quotes, as in the parsed expression
+	SEXI_BINARY_NUM = 4, // any number as text
+	SEXI_BINARY_INT = 5, // number without leading zeros that fits in 64 bits, stored as its value
+	SEXI_BINARY_SINT = 6, // negative integer, stored as its zigzag-encoded value
+	SEXI_BINARY_DOUBLE = 7, // decimal number, a count of 0 followed by the 8 bytes of its IEEE 754 double, least significant first
+
+	SEXI_BINARY_TAG_COUNT
+} SexiBinaryTag;
+
+/**
+ * @brief Encode expressions into a buffer.
+ * Like \ref sexiExprWrite , at most \p cap bytes are written and the full
+ * size is returned regardless, so a \p cap of 0 only measures the encoding.
+ * @param n number of expressions to encode
+ * @param exprs expressions to encode
+ * @param buf buffer to write into, may be `NULL` if \p cap is 0
+ * @param cap size of \p buf
+ * @returns size of the encoding, or 0 if there was no memory to encode with
+ */
+size_t sexiEncodeBinary(size_t n, const SexiExprConst *exprs, void *buf, size_t cap);
+
+/**
+ * @brief Decode expressions encoded by \ref sexiEncodeBinary .
+ * Without `copyStrs` ids, strings and numbers stored as text reference \p ptr
+ * directly, so it must outlive the result. `numThreads`, `locations`, `recover` and `lazyDepth` are ignored.
+ * @param len size of the data
+ * @param ptr pointer to the data
+ * @param opts parsing options or `NULL` for the defaults
+ * @returns newly created parse result, containing an error if the data is malformed
+ * @see sexiDestroyParseResult
+ */
+SexiParseResult sexiDecodeBinary(size_t len, const void *ptr, const SexiParseOptions *opts);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+
+namespace sexi{
+	inline std::string encodeBinary(ExprSpan exprs){
+		std::string ret(sexiEncodeBinary(exprs.size(), exprs.data(), nullptr, 0), '\0');
+		sexiEncodeBinary(exprs.size(), exprs.data(), ret.data(), ret.size());
+		return ret;
+	}
+
+	inline ParseResult decodeBinary(std::string_view data, const SexiParseOptions *opts = nullptr){
+		return ParseResult(sexiDecodeBinary(data.size(), data.data(), opts));
+	}
+}
+#endif // __cplusplus
+
+/**
+ * @}
+ */
+
+#endif // !SEXI_BINARY_H
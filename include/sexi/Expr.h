@@ -12,6 +12,7 @@ extern "C" {
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * @brief Enumeration of possible types of expression.
@@ -56,8 +57,37 @@ typedef struct SexiExprT *SexiExpr;
  */
 typedef const struct SexiExprT *SexiExprConst;
 
+/**
+ * @brief Functions the library allocates memory with.
+ * They behave like `malloc` , `realloc` and `free` , and get `userdata` as
+ * their first argument. Memory is always freed through the allocator that
+ * allocated it, so an allocator must stay valid as long as anything allocated
+ * through it.
+ */
+typedef struct {
+	void *(*alloc)(void *userdata, size_t size);
+	void *(*realloc)(void *userdata, void *ptr, size_t size);
+	void (*free)(void *userdata, void *ptr);
+	void *userdata;
+} SexiAllocator;
+
+/**
+ * @brief Set the allocator used wherever none is given explicitly.
+ * Only the pointer is kept, and memory allocated before the change keeps
+ * using the allocator it came from.
+ * @param alloc allocator to use, or `NULL` for `malloc` and friends
+ */
+void sexiSetDefaultAllocator(const SexiAllocator *alloc);
+
+/**
+ * @brief Get the allocator used wherever none is given explicitly.
+ * @returns the default allocator
+ */
+const SexiAllocator *sexiGetDefaultAllocator(void);
+
 /**
  * @brief Destroy an expression.
+ * Its memory goes back to the allocator it was created with.
  * @param expr
  */
 void sexiDestroyExpr(SexiExpr expr);
@@ -83,6 +113,21 @@ SexiExpr sexiCreateEmpty();
  */
 SexiExpr sexiCreateList(size_t n, const SexiExprConst *exprs);
 
+/**
+ * @brief Append an element to a list in place, taking ownership of it.
+ * Storage grows geometrically, so appending is amortized constant time.
+ * An empty expression becomes a list of one element.
+ * @param list list or empty expression created by \ref sexiCreateList ,
+ *             \ref sexiCreateEmpty or \ref sexiCloneExpr ; never one owned by
+ *             a parse result or pool
+ * @param elem expression to append, which must be owned by the caller and
+ *             is owned by \p list afterwards
+ * @returns whether \p elem was appended, which fails if there's no memory or
+ *          \p list is neither a list nor empty or isn't one created by hand;
+ *          on failure both are left untouched
+ */
+bool sexiExprAppend(SexiExpr list, SexiExpr elem);
+
 /**
  * @brief Create an ID expression.
  * @param str the identifier
@@ -99,11 +144,54 @@ SexiExpr sexiCreateStr(SexiStr str);
 
 /**
  * @brief Create a number expression.
+ * Trailing zeros after a decimal point are dropped from \p str and its value
+ * is decoded once, see \ref sexiExprAsInt .
  * @param str the string
  * @returns newly created expression
  */
 SexiExpr sexiCreateNum(SexiStr str);
 
+/**
+ * @brief Create a number expression from a signed integer.
+ * @param val value of the number
+ * @returns newly created expression
+ */
+SexiExpr sexiCreateInt(int64_t val);
+
+/**
+ * @brief Create a number expression from an unsigned integer.
+ * @param val value of the number
+ * @returns newly created expression
+ */
+SexiExpr sexiCreateUint(uint64_t val);
+
+/**
+ * @brief Create a number expression from a double.
+ * The text is the shortest that reads back as \p val , written without an
+ * exponent unless that takes more than 32 characters.
+ * @param val value of the number
+ * @returns newly created expression
+ */
+SexiExpr sexiCreateDouble(double val);
+
+/**
+ * @name Allocator-aware constructors
+ * Same as the functions without the `Ex` suffix, but allocate the new
+ * expression through \p alloc , or the default allocator if it's `NULL` .
+ * Elements cloned into a list are allocated through \p alloc as well.
+ * @{
+ */
+SexiExpr sexiCloneExprEx(SexiExprConst expr, const SexiAllocator *alloc);
+SexiExpr sexiCreateEmptyEx(const SexiAllocator *alloc);
+SexiExpr sexiCreateListEx(size_t n, const SexiExprConst *exprs, const SexiAllocator *alloc);
+SexiExpr sexiCreateIdEx(SexiStr str, const SexiAllocator *alloc);
+SexiExpr sexiCreateStrEx(SexiStr str, const SexiAllocator *alloc);
+SexiExpr sexiCreateNumEx(SexiStr str, const SexiAllocator *alloc);
+SexiExpr sexiCreateIntEx(int64_t val, const SexiAllocator *alloc);
+SexiExpr sexiCreateUintEx(uint64_t val, const SexiAllocator *alloc);
+SexiExpr sexiCreateDoubleEx(double val, const SexiAllocator *alloc);
+/** @} */
+
 /**
  * @brief Get the type of an expression.
  * @param expr the expression to query
@@ -148,21 +236,99 @@ bool sexiExprIsNum(SexiExprConst expr);
 
 /**
  * @brief Get the string representation of an expression.
+ * Deprecated for lists, which have no text of their own: they give an empty
+ * string, use \ref sexiExprWrite or \ref sexiExprWriteSink to write them.
  * @param expr expression to query
- * @returns the expression represented as a string
+ * @returns the expression represented as a string, empty with a `NULL` pointer for lists
  */
 SexiStr sexiExprToStr(SexiExprConst expr);
 
+/**
+ * @brief Write the text of an expression into a buffer.
+ * Like `snprintf` , at most \p cap - 1 characters are written followed by a
+ * null terminator, and the full length is returned regardless; a \p cap of 0
+ * only measures the text.
+ * @param expr expression to write
+ * @param buf buffer to write into, may be `NULL` if \p cap is 0
+ * @param cap size of \p buf
+ * @returns length of the text of \p expr , not counting the null terminator
+ */
+size_t sexiExprWrite(SexiExprConst expr, char *buf, size_t cap);
+
+/**
+ * @brief Callback receiving the text of an expression piece by piece.
+ * @param user user data passed to \ref sexiExprWriteSink
+ * @param str next piece of text, only valid during the call
+ * @returns whether to keep writing
+ */
+typedef bool(*SexiWriteFn)(void *user, SexiStr str);
+
+/**
+ * @brief Write the text of an expression to a callback.
+ * The text is handed over in chunks of a few kilobytes.
+ * @param expr expression to write
+ * @param fn function receiving the text
+ * @param user user data passed to \p fn
+ * @returns whether all of the text was accepted by \p fn
+ */
+bool sexiExprWriteSink(SexiExprConst expr, SexiWriteFn fn, void *user);
+
+/**
+ * @brief Write the text of an expression to a file descriptor.
+ * @param expr expression to write
+ * @param fd file descriptor to write to
+ * @returns whether all of the text was written
+ */
+bool sexiExprWriteFd(SexiExprConst expr, int fd);
+
 /**
  * @brief Get the length of an expression.
  * Empty expression always return 0, and non-list expressions always return 1.
  * @param expr expression to query
- * @returns number of elements in the expression
+ * @returns number of elements in the expression, 0 for a lazy list there was no memory to build
  */
 size_t sexiExprLength(SexiExprConst expr);
 
+/**
+ * @brief Outcome of converting a number expression to a native value.
+ */
+typedef enum {
+	SEXI_NUM_OK,
+	SEXI_NUM_OUT_OF_RANGE, // the value overflows the requested type, the output is clamped
+	SEXI_NUM_NOT_INTEGER, // an integer was requested for a fraction, the output is truncated
+	SEXI_NUM_INVALID, // not a number expression or not a decimal number, the output is untouched
+} SexiNumStatus;
+
+/**
+ * @brief Get the value of a number expression as a signed integer.
+ * Numbers are decoded when the expression is created, so this doesn't look
+ * at the text again.
+ * @param expr expression to query
+ * @param out where to store the value
+ * @returns whether the value fits
+ */
+SexiNumStatus sexiExprAsInt(SexiExprConst expr, int64_t *out);
+
+/**
+ * @brief Get the value of a number expression as an unsigned integer, like \ref sexiExprAsInt .
+ * @param expr expression to query
+ * @param out where to store the value
+ * @returns whether the value fits
+ */
+SexiNumStatus sexiExprAsUint(SexiExprConst expr, uint64_t *out);
+
+/**
+ * @brief Get the value of a number expression as a double.
+ * Integers beyond 2^53 are rounded to the nearest double.
+ * @param expr expression to query
+ * @param out where to store the value
+ * @returns whether the value fits, numbers too large or small for a double are out of range
+ */
+SexiNumStatus sexiExprAsDouble(SexiExprConst expr, double *out);
+
 /**
  * @brief Set the expression as having a copy of the referenced expression string.
+ * Does nothing for expressions owned by a parse result or pool, see `copyStrs` .
  * @param expr expression to modify
  */
 void sexiExprOwnString(SexiExpr expr);
@@ -171,13 +337,158 @@ void sexiExprOwnString(SexiExpr expr);
  * @brief Get an element of a list expression
  * @param list list expression to query
  * @param idx index of the list element
- * @returns element at \p idx of \p list .
+ * @returns element at \p idx of \p list , or `NULL` for a lazy list there was no memory to build
  */
 SexiExprConst sexiExprAt(SexiExprConst list, size_t idx);
 
+/**
+ * @brief Check whether two expressions have the same value.
+ * Expressions compare by type and text, element by element for lists,
+ * without recursing. Shared subtrees are equal without a look inside, so
+ * expressions of the same \ref SexiExprPool are compared in constant time.
+ * @param lhs first expression
+ * @param rhs second expression
+ * @returns whether \p lhs and \p rhs are equal, false if a lazy list in them couldn't be built
+ */
+bool sexiExprEqual(SexiExprConst lhs, SexiExprConst rhs);
+
+/**
+ * @brief Get a 64-bit hash of the value of an expression.
+ * Equal expressions hash the same, see \ref sexiExprEqual . Lists of a parse
+ * result or pool remember their hash, so hashing one again or hashing a list
+ * containing it doesn't revisit its elements; this is safe from several
+ * threads at once. Lists created by hand may still be appended to anywhere
+ * inside, so they're hashed in full every time.
+ * Hashes are only stable within a single build of the library.
+ * @param expr expression to hash
+ * @returns the hash, or 0 if a lazy list in \p expr couldn't be built
+ */
+uint64_t sexiExprHash(SexiExprConst expr);
+
+/**
+ * @brief Symbol of anything but an interned id.
+ */
+#define SEXI_NO_SYMBOL UINT32_MAX
+
+/**
+ * @brief Opaque type representing a table of interned ids.
+ * Each distinct id added to a table gets the next symbol, starting at 0.
+ * Tables are safe to use from several threads at once.
+ */
+typedef struct SexiSymbolTableT *SexiSymbolTable;
+
+/**
+ * @brief Create an empty symbol table.
+ * @returns newly created table
+ * @see sexiDestroySymbolTable
+ */
+SexiSymbolTable sexiCreateSymbolTable(void);
+
+/**
+ * @brief Destroy a symbol table created by \ref sexiCreateSymbolTable .
+ * Expressions interned into the table reference its strings, so they must be
+ * destroyed first.
+ * @param table table to destroy
+ */
+void sexiDestroySymbolTable(SexiSymbolTable table);
+
+/**
+ * @brief Get the symbol of a string, adding it to a table if it's new.
+ * @param table table to add to
+ * @param str the identifier
+ * @returns symbol of \p str , or `SEXI_NO_SYMBOL` if it couldn't be added
+ */
+uint32_t sexiSymbolTableIntern(SexiSymbolTable table, SexiStr str);
+
+/**
+ * @brief Get the symbol of a string without adding it.
+ * @param table table to query
+ * @param str the identifier
+ * @returns symbol of \p str , or `SEXI_NO_SYMBOL` if it isn't in \p table
+ */
+uint32_t sexiSymbolTableFind(SexiSymbolTable table, SexiStr str);
+
+/**
+ * @brief Get the number of symbols in a table.
+ * @param table table to query
+ * @returns number of symbols
+ */
+size_t sexiSymbolTableSize(SexiSymbolTable table);
+
+/**
+ * @brief Get the string of a symbol.
+ * @param table table to query
+ * @param sym symbol to look up
+ * @returns the table's copy of the string, or a `NULL` string of 0 length if \p sym isn't in \p table
+ */
+SexiStr sexiSymbolTableStr(SexiSymbolTable table, uint32_t sym);
+
+/**
+ * @brief Get the symbol of an id interned while parsing.
+ * @param expr expression to query
+ * @returns the symbol, or `SEXI_NO_SYMBOL` if \p expr isn't an interned id
+ * @see SexiParseOptions
+ */
+uint32_t sexiExprSymbol(SexiExprConst expr);
+
+/**
+ * @brief Opaque type representing a pool of unique expressions.
+ * A pool holds at most one expression of each value, so expressions from the
+ * same pool are equal exactly when they are the same pointer, and identical
+ * subtrees share their memory. Pooled expressions are owned by the pool and
+ * must never be passed to \ref sexiDestroyExpr .
+ * Pools are safe to use from several threads at once.
+ */
+typedef struct SexiExprPoolT *SexiExprPool;
+
+/**
+ * @brief Create an empty expression pool.
+ * @returns newly created pool
+ * @see sexiDestroyExprPool
+ */
+SexiExprPool sexiCreateExprPool(void);
+
+/**
+ * @brief Destroy an expression pool created by \ref sexiCreateExprPool , with all of its expressions.
+ * @param pool pool to destroy
+ */
+void sexiDestroyExprPool(SexiExprPool pool);
+
+/**
+ * @brief Get the expression of a pool equal to another, adding it if it's new.
+ * Elements of a list that are already pooled are not visited again.
+ * @param pool pool to add to
+ * @param expr expression to look up, which may belong to the pool already
+ * @returns the pooled expression or `NULL` on allocation failure
+ */
+SexiExprConst sexiExprPoolIntern(SexiExprPool pool, SexiExprConst expr);
+
+/**
+ * @brief Deduplicating version of \ref sexiCreateList .
+ * Instead of cloning the elements, the list and any new elements are added to
+ * \p pool and an existing equal list is returned if there is one.
+ * @param pool pool to add to
+ * @param n number of elements
+ * @param exprs elements of the list, which may belong to the pool already
+ * @returns the pooled list or `NULL` on allocation failure
+ */
+SexiExprConst sexiExprPoolList(SexiExprPool pool, size_t n, const SexiExprConst *exprs);
+
+/**
+ * @brief Get the number of unique expressions in a pool.
+ * @param pool pool to query
+ * @returns number of expressions
+ */
+size_t sexiExprPoolSize(SexiExprPool pool);
+
 #ifdef __cplusplus
 }
 
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <string_view>
 #include <string>
@@ -201,18 +512,88 @@ namespace sexi{
 
 	class ExprIter;
 
+	/**
+	 * @brief Non-owning handle to an immutable expression.
+	 * Only valid while the expression it refers to is alive; construct an
+	 * \ref Expr from it to keep a copy.
+	 */
+	class ExprRef{
+		public:
+			ExprRef(SexiExprConst expr_) noexcept
+				: m_expr(expr_){}
+
+			operator SexiExprConst() const noexcept{ return m_expr; }
+
+			SexiExprType type() const noexcept{ return sexiExprType(m_expr); }
+
+			std::size_t length() const noexcept{ return sexiExprLength(m_expr); }
+
+			ExprRef operator[](std::size_t idx) const noexcept{ return sexiExprAt(m_expr, idx); }
+
+			/**
+			 * @brief View the string of an id, string, number or empty expression without copying it.
+			 */
+			std::string_view str() const noexcept{
+				auto ret = sexiExprToStr(m_expr);
+				return { ret.ptr, ret.len };
+			}
+
+			std::string toStr() const{
+				std::string ret;
+				appendTo(ret);
+				return ret;
+			}
+
+			/**
+			 * @brief Append the text of the expression to \p out .
+			 */
+			void appendTo(std::string &out) const{
+				sexiExprWriteSink(m_expr, [](void *user, SexiStr str){
+					static_cast<std::string*>(user)->append(str.ptr, str.len);
+					return true;
+				}, &out);
+			}
+
+			std::uint32_t symbol() const noexcept{ return sexiExprSymbol(m_expr); }
+
+			SexiNumStatus asInt(std::int64_t &out) const noexcept{ return sexiExprAsInt(m_expr, &out); }
+			SexiNumStatus asUint(std::uint64_t &out) const noexcept{ return sexiExprAsUint(m_expr, &out); }
+			SexiNumStatus asDouble(double &out) const noexcept{ return sexiExprAsDouble(m_expr, &out); }
+
+			bool isEmpty() const noexcept{ return sexiExprIsEmpty(m_expr); }
+			bool isList() const noexcept{ return sexiExprIsList(m_expr); }
+			bool isId() const noexcept{ return sexiExprIsId(m_expr); }
+			bool isStr() const noexcept{ return sexiExprIsStr(m_expr); }
+			bool isNum() const noexcept{ return sexiExprIsNum(m_expr); }
+
+			ExprIter begin() const noexcept;
+			ExprIter end() const noexcept;
+
+		private:
+			SexiExprConst m_expr;
+	};
+
 	class Expr{
 		public:
 			Expr(SexiExprConst expr_, bool makeClone = true)
 				: m_ownsExpr(makeClone), m_expr(makeClone ? sexiCloneExpr(expr_) : expr_){}
 
+			/**
+			 * @brief Make an owned copy of the expression referenced by \p ref .
+			 */
+			Expr(ExprRef ref)
+				: Expr(static_cast<SexiExprConst>(ref)){}
+
 			explicit Expr(TypeTag<SEXI_EMPTY> = empty) noexcept
 				: m_ownsExpr(true), m_owned(sexiCreateEmpty()){}
 
 			Expr(TypeTag<SEXI_LIST>, size_t n, SexiExprConst *exprs) noexcept
 				: m_ownsExpr(true), m_owned(sexiCreateList(n, exprs)){}
 
-			Expr(TypeTag<SEXI_LIST>, std::vector<Expr> &&others) = delete;
+			/**
+			 * @brief Create a list that takes the elements of \p others instead of cloning them.
+			 */
+			Expr(TypeTag<SEXI_LIST>, std::vector<Expr> &&others) noexcept;
 
 			Expr(TypeTag<SEXI_LIST>, const std::vector<Expr> &others) noexcept
 				: m_ownsExpr(true), m_owned(nullptr)
@@ -245,29 +626,19 @@ namespace sexi{
 				if(copyStr) sexiExprOwnString(m_owned);
 			}
 
-			Expr(TypeTag<SEXI_NUM>, int val) noexcept
-				: m_ownsExpr(true), m_owned(nullptr)
-			{
-				auto str = std::to_string(val);
-				m_owned = sexiCreateNum({ .len = str.size(), .ptr = str.data() });
-				sexiExprOwnString(m_owned);
-			}
+			template<typename Int, std::enable_if_t<std::is_integral_v<Int> && !std::is_same_v<Int, bool>, int> = 0>
+			Expr(TypeTag<SEXI_NUM>, Int val) noexcept
+				: m_ownsExpr(true)
+				, m_owned(std::is_signed_v<Int> ? sexiCreateInt(std::int64_t(val)) : sexiCreateUint(std::uint64_t(val))){}
 
-			Expr(TypeTag<SEXI_NUM>, unsigned long long val) noexcept
-				: m_ownsExpr(true), m_owned(nullptr)
-			{
-				auto str = std::to_string(val);
-				m_owned = sexiCreateNum({ .len = str.size(), .ptr = str.data() });
-				sexiExprOwnString(m_owned);
-			}
+			Expr(TypeTag<SEXI_NUM>, double val) noexcept
+				: m_ownsExpr(true), m_owned(sexiCreateDouble(val)){}
 
+			/**
+			 * @brief Create a number from the double nearest to \p val .
+			 */
 			Expr(TypeTag<SEXI_NUM>, long double val) noexcept
-				: m_ownsExpr(true), m_owned(nullptr)
-			{
-				auto str = std::to_string(val);
-				m_owned = sexiCreateNum({ .len = str.size(), .ptr = str.data() });
-				sexiExprOwnString(m_owned);
-			}
+				: Expr(num, double(val)){}
 
 			explicit Expr(std::string_view str, bool copyStr = true) noexcept
 			{
@@ -295,7 +666,7 @@ namespace sexi{
 				: Expr(num, val){}
 
 			explicit Expr(double val) noexcept
-				: Expr(num, (long double)val){}
+				: Expr(num, val){}
 
 			/*
 			explicit Expr(bool val) noexcept
@@ -347,23 +718,49 @@ namespace sexi{
 				}
 			}
 
+			/**
+			 * @brief Take ownership of an expression created by one of the `sexiCreate` functions.
+			 */
+			static Expr adopt(SexiExpr expr) noexcept{ return Expr(expr, AdoptTag{}); }
+
+			/**
+			 * @brief Give up the expression, cloning it first if it isn't owned.
+			 * @returns an expression the caller must destroy
+			 */
+			SexiExpr release() && noexcept{
+				auto ret = m_ownsExpr ? m_owned : sexiCloneExpr(m_expr);
+				m_expr = nullptr;
+				m_ownsExpr = false;
+				return ret;
+			}
+
 			operator SexiExprConst() const noexcept{ return m_expr; }
+			operator ExprRef() const noexcept{ return m_expr; }
+
+			ExprRef ref() const noexcept{ return m_expr; }
 
 			SexiExprType type() const noexcept{ return sexiExprType(m_expr); }
 
 			std::size_t length() const noexcept{ return sexiExprLength(m_expr); }
 
-			Expr operator[](std::size_t idx) const noexcept{
+			ExprRef operator[](std::size_t idx) const noexcept{
 				return sexiExprAt(m_expr, idx);
 			}
 
-			std::string toStr() const noexcept{
-				auto str = sexiExprToStr(m_expr);
-				return std::string(str.ptr, str.len);
-			}
+			std::string_view str() const noexcept{ return ref().str(); }
+
+			std::string toStr() const{ return ref().toStr(); }
+
+			void appendTo(std::string &out) const{ ref().appendTo(out); }
 
 			std::vector<Expr> toList() const noexcept;
 
+			std::uint32_t symbol() const noexcept{ return sexiExprSymbol(m_expr); }
+
+			SexiNumStatus asInt(std::int64_t &out) const noexcept{ return sexiExprAsInt(m_expr, &out); }
+			SexiNumStatus asUint(std::uint64_t &out) const noexcept{ return sexiExprAsUint(m_expr, &out); }
+			SexiNumStatus asDouble(double &out) const noexcept{ return sexiExprAsDouble(m_expr, &out); }
+
 			bool isEmpty() const noexcept{ return sexiExprIsEmpty(m_expr); }
 			bool isList() const noexcept{ return sexiExprIsList(m_expr); }
 			bool isId() const noexcept{ return sexiExprIsId(m_expr); }
@@ -374,6 +771,11 @@ namespace sexi{
 			ExprIter end() const noexcept;
 
 		private:
+			struct AdoptTag{};
+
+			Expr(SexiExpr expr, AdoptTag) noexcept
+				: m_ownsExpr(true), m_owned(expr){}
+
 			bool m_ownsExpr;
 			union{
 				SexiExprConst m_expr;
@@ -396,47 +798,233 @@ namespace sexi{
 				return (m_expr == other.m_expr) && (m_idx == other.m_idx);
 			}
 
-			Expr operator*() const noexcept{ return m_expr[m_idx]; }
+			ExprRef operator*() const noexcept{ return sexiExprAt(m_expr, m_idx); }
 
 		private:
-			ExprIter(Expr expr, std::size_t idx) noexcept
+			ExprIter(SexiExprConst expr, std::size_t idx) noexcept
 					: m_expr(expr), m_idx(idx){}
 
-			Expr m_expr;
+			SexiExprConst m_expr;
 			std::size_t m_idx;
 
 			friend class Expr;
+			friend class ExprRef;
 	};
 
-	inline ExprIter Expr::begin() const noexcept{ return ExprIter(*this, 0); }
-	inline ExprIter Expr::end() const noexcept{ return ExprIter(*this, length()); }
-}
+	inline ExprIter ExprRef::begin() const noexcept{ return ExprIter(m_expr, 0); }
+	inline ExprIter ExprRef::end() const noexcept{ return ExprIter(m_expr, length()); }
 
-namespace sexi::operators{
-	inline Expr operator<<(const Expr &lhs, const Expr &rhs){
-		if(lhs.isList()){
-			std::vector<Expr> exprs = lhs.toList();
-			exprs.emplace_back(rhs);
-			return Expr(list, exprs);
-		}
-		else{
-			std::vector<Expr> exprs = { lhs, rhs };
-			return Expr(list, exprs);
+	inline ExprIter Expr::begin() const noexcept{ return ExprIter(m_expr, 0); }
+	inline ExprIter Expr::end() const noexcept{ return ExprIter(m_expr, length()); }
+
+	/**
+	 * @brief Non-owning view of an array of expressions.
+	 */
+	class ExprSpan{
+		public:
+			class Iter{
+				public:
+					Iter &operator++() noexcept{
+						++m_it;
+						return *this;
+					}
+
+					bool operator==(const Iter &other) const noexcept{ return m_it == other.m_it; }
+					bool operator!=(const Iter &other) const noexcept{ return m_it != other.m_it; }
+
+					ExprRef operator*() const noexcept{ return *m_it; }
+
+				private:
+					explicit Iter(const SexiExprConst *it) noexcept
+						: m_it(it){}
+
+					const SexiExprConst *m_it;
+
+					friend class ExprSpan;
+			};
+
+			ExprSpan(const SexiExprConst *exprs, std::size_t n) noexcept
+				: m_exprs(exprs), m_n(n){}
+
+			std::size_t size() const noexcept{ return m_n; }
+			bool empty() const noexcept{ return m_n == 0; }
+
+			const SexiExprConst *data() const noexcept{ return m_exprs; }
+
+			ExprRef operator[](std::size_t idx) const noexcept{ return m_exprs[idx]; }
+
+			Iter begin() const noexcept{ return Iter(m_exprs); }
+			Iter end() const noexcept{ return Iter(m_exprs + m_n); }
+
+		private:
+			const SexiExprConst *m_exprs;
+			std::size_t m_n;
+	};
+
+	inline bool operator==(ExprRef lhs, ExprRef rhs) noexcept{ return sexiExprEqual(lhs, rhs); }
+	inline bool operator==(const Expr &lhs, const Expr &rhs) noexcept{ return sexiExprEqual(lhs, rhs); }
+	inline bool operator==(ExprRef lhs, const Expr &rhs) noexcept{ return sexiExprEqual(lhs, rhs); }
+	inline bool operator==(const Expr &lhs, ExprRef rhs) noexcept{ return sexiExprEqual(lhs, rhs); }
+
+	inline bool operator!=(ExprRef lhs, ExprRef rhs) noexcept{ return !sexiExprEqual(lhs, rhs); }
+	inline bool operator!=(const Expr &lhs, const Expr &rhs) noexcept{ return !sexiExprEqual(lhs, rhs); }
+	inline bool operator!=(ExprRef lhs, const Expr &rhs) noexcept{ return !sexiExprEqual(lhs, rhs); }
+	inline bool operator!=(const Expr &lhs, ExprRef rhs) noexcept{ return !sexiExprEqual(lhs, rhs); }
+
+	template<typename Exprs>
+	inline bool operator==(ExprSpan lhs, const Exprs &rhs) noexcept{
+		if(lhs.size() != std::size(rhs)) return false;
+
+		auto it = std::begin(rhs);
+		for(auto expr : lhs){
+			if(!sexiExprEqual(expr, *it)) return false;
+			++it;
 		}
+
+		return true;
 	}
 
-	template<typename T>
-	inline Expr operator<<(const Expr &lhs, T &&val){
-		if(lhs.isList()){
-			std::vector<Expr> exprs = lhs.toList();
-			exprs.emplace_back(Expr(std::forward<T>(val)));
-			return Expr(list, exprs);
+	template<typename Exprs>
+	inline bool operator!=(ExprSpan lhs, const Exprs &rhs) noexcept{ return !(lhs == rhs); }
+
+	/**
+	 * @brief Builds a list by moving elements into it, in amortized constant time per element.
+	 */
+	class ListBuilder{
+		public:
+			ListBuilder() noexcept
+				: m_list(Expr::adopt(sexiCreateEmpty())){}
+
+			ListBuilder(const ListBuilder&) = delete;
+			ListBuilder(ListBuilder&&) noexcept = default;
+
+			ListBuilder &operator=(const ListBuilder&) = delete;
+			ListBuilder &operator=(ListBuilder&&) noexcept = default;
+
+			std::size_t size() const noexcept{ return m_list.length(); }
+
+			ListBuilder &append(Expr &&expr) noexcept{
+				auto elem = std::move(expr).release();
+				if(!sexiExprAppend(m_owned(), elem)) sexiDestroyExpr(elem);
+				return *this;
+			}
+
+			template<typename T>
+			ListBuilder &append(T &&val) noexcept{ return append(Expr(std::forward<T>(val))); }
+
+			template<typename T>
+			ListBuilder &operator<<(T &&val) noexcept{ return append(std::forward<T>(val)); }
+
+			/**
+			 * @brief Hand out the finished list, leaving the builder empty.
+			 */
+			Expr build() noexcept{ return std::exchange(m_list, Expr::adopt(sexiCreateEmpty())); }
+
+		private:
+			SexiExpr m_owned() noexcept{ return const_cast<SexiExpr>(static_cast<SexiExprConst>(m_list)); }
+
+			Expr m_list;
+	};
+
+	inline Expr::Expr(TypeTag<SEXI_LIST>, std::vector<Expr> &&others) noexcept
+		: m_ownsExpr(true), m_owned(sexiCreateEmpty())
+	{
+		for(auto &&other : others){
+			auto elem = std::move(other).release();
+			if(!sexiExprAppend(m_owned, elem)) sexiDestroyExpr(elem);
 		}
-		else{
-			std::vector<Expr> exprs = { lhs, Expr(std::forward<T>(val)) };
-			return Expr(list, exprs);
+
+		others.clear();
+	}
+
+	class SymbolTable{
+		public:
+			SymbolTable()
+				: m_table(sexiCreateSymbolTable()){}
+
+			SymbolTable(const SymbolTable&) = delete;
+
+			~SymbolTable(){ sexiDestroySymbolTable(m_table); }
+
+			SymbolTable &operator=(const SymbolTable&) = delete;
+
+			std::uint32_t intern(std::string_view str){ return sexiSymbolTableIntern(m_table, { .len = str.size(), .ptr = str.data() }); }
+			std::uint32_t find(std::string_view str) const{ return sexiSymbolTableFind(m_table, { .len = str.size(), .ptr = str.data() }); }
+
+			std::size_t size() const{ return sexiSymbolTableSize(m_table); }
+
+			std::string_view str(std::uint32_t sym) const{
+				auto ret = sexiSymbolTableStr(m_table, sym);
+				return { ret.ptr, ret.len };
+			}
+
+			SexiSymbolTable handle() const noexcept{ return m_table; }
+
+		private:
+			SexiSymbolTable m_table;
+	};
+
+	class ExprPool{
+		public:
+			ExprPool()
+				: m_pool(sexiCreateExprPool()){}
+
+			ExprPool(const ExprPool&) = delete;
+
+			~ExprPool(){ sexiDestroyExprPool(m_pool); }
+
+			ExprPool &operator=(const ExprPool&) = delete;
+
+			ExprRef intern(SexiExprConst expr){ return sexiExprPoolIntern(m_pool, expr); }
+			ExprRef list(ExprSpan exprs){ return sexiExprPoolList(m_pool, exprs.size(), exprs.data()); }
+
+			std::size_t size() const{ return sexiExprPoolSize(m_pool); }
+
+			SexiExprPool handle() const noexcept{ return m_pool; }
+
+		private:
+			SexiExprPool m_pool;
+	};
+}
+
+namespace sexi::operators{
+	/**
+	 * @brief Append \p rhs to the list \p lhs , or make a list of both if \p lhs isn't one.
+	 * The storage of \p lhs is reused, so chains of `<<` build lists in linear time.
+	 */
+	inline Expr operator<<(Expr &&lhs, Expr &&rhs){
+		if(!lhs.isList()){
+			ListBuilder ret;
+			ret << std::move(lhs) << std::move(rhs);
+			return ret.build();
 		}
+
+		auto list = std::move(lhs).release();
+		auto elem = std::move(rhs).release();
+		if(!sexiExprAppend(list, elem)) sexiDestroyExpr(elem);
+
+		return Expr::adopt(list);
 	}
+
+	template<typename T>
+	inline Expr operator<<(Expr &&lhs, T &&val){ return std::move(lhs) << Expr(std::forward<T>(val)); }
+
+	inline Expr operator<<(const Expr &lhs, const Expr &rhs){ return Expr(lhs) << Expr(rhs); }
+
+	template<typename T>
+	inline Expr operator<<(const Expr &lhs, T &&val){ return Expr(lhs) << Expr(std::forward<T>(val)); }
+}
+
+namespace std{
+	template<>
+	struct hash<sexi::ExprRef>{
+		std::size_t operator()(sexi::ExprRef expr) const noexcept{ return std::size_t(sexiExprHash(expr)); }
+	};
+
+	template<>
+	struct hash<sexi::Expr>{
+		std::size_t operator()(const sexi::Expr &expr) const noexcept{ return std::size_t(sexiExprHash(expr)); }
+	};
 }
 
 using namespace sexi::operators;
@@ -0,0 +1,328 @@
+#ifndef SEXI_TAPE_H
+#define SEXI_TAPE_H 1
+
+#include "../sexi.h"
+
+/**
+ * @defgroup Tapes Tapes
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/**
+ * @brief A single expression on a tape.
+ *
+ * The expressions of a tape are stored in pre-order, so the elements of a list
+ * directly follow it and the next sibling of an expression is \ref skip
+ * entries after it.
+ */
+typedef struct {
+	/**
+	 * @brief A \ref SexiExprType .
+	 */
+	uint32_t type;
+
+	/**
+	 * @brief Number of elements of a list or empty list, or length of the string of anything else.
+	 */
+	uint32_t len;
+
+	union {
+		/**
+		 * @brief Number of entries in the subtree of a list or empty list, including itself.
+		 */
+		uint64_t skip;
+
+		/**
+		 * @brief Offset of the string of an id, string or number from \ref sexiTapeStrBase .
+		 */
+		uint64_t off;
+	};
+} SexiTapeEntry;
+
+/**
+ * @brief Opaque type representing a parsed tape.
+ */
+typedef struct SexiTapeT *SexiTape;
+
+/**
+ * @brief Parse s-expressions from a string into a flat tape.
+ * Tapes use a fraction of the memory of a tree and can be scanned linearly.
+ * `numThreads`, `symbols`, `pool`, `locations`, `recover` and `lazyDepth` are ignored.
+ * @param len length of the string
+ * @param ptr pointer to the string
+ * @param opts parsing options or `NULL` for the defaults; without `copyStrs` the tape references \p ptr
+ * @returns newly created tape
+ * @see sexiDestroyTape
+ */
+SexiTape sexiParseTape(size_t len, const char *ptr, const SexiParseOptions *opts);
+
+/**
+ * @brief Destroy a tape created by \ref sexiParseTape .
+ * @param tape tape to destroy
+ */
+void sexiDestroyTape(SexiTape tape);
+
+/**
+ * @brief Check if a tape contains an error.
+ * @param tape tape to check
+ * @returns whether the tape contains an error
+ */
+bool sexiTapeHasError(SexiTape tape);
+
+/**
+ * @brief Get the error string from a tape.
+ * @param tape tape to query
+ * @returns error string or a `NULL` string of 0 length
+ */
+SexiStr sexiTapeError(SexiTape tape);
+
+/**
+ * @brief Get the number of top-level expressions on a tape.
+ * The first one is at index 0, each following one at \ref sexiTapeNext of the last.
+ * @param tape tape to query
+ * @returns number of top-level expressions
+ */
+size_t sexiTapeNumExprs(SexiTape tape);
+
+/**
+ * @brief Get the number of entries on a tape.
+ * @param tape tape to query
+ * @returns number of entries
+ */
+size_t sexiTapeSize(SexiTape tape);
+
+/**
+ * @brief Get the entries of a tape.
+ * @param tape tape to query
+ * @returns pointer to the entries or `NULL`
+ */
+const SexiTapeEntry *sexiTapeEntries(SexiTape tape);
+
+/**
+ * @brief Get the base that the string offsets of a tape are relative to.
+ * @param tape tape to query
+ * @returns pointer to the string pool or source
+ */
+const char *sexiTapeStrBase(SexiTape tape);
+
+/**
+ * @brief Get the type of an expression on a tape.
+ * @param tape tape to query
+ * @param idx index of the expression
+ * @returns type of the expression
+ */
+SexiExprType sexiTapeType(SexiTape tape, size_t idx);
+
+/**
+ * @brief Get the length of an expression on a tape, like \ref sexiExprLength .
+ * @param tape tape to query
+ * @param idx index of the expression
+ * @returns number of elements in the expression
+ */
+size_t sexiTapeLength(SexiTape tape, size_t idx);
+
+/**
+ * @brief Get an element of a list on a tape, like \ref sexiExprAt .
+ * Takes time linear in \p elemIdx ; use \ref sexiTapeNext to walk all elements.
+ * @param tape tape to query
+ * @param list index of the list
+ * @param elemIdx index of the list element
+ * @returns index of the element
+ */
+size_t sexiTapeAt(SexiTape tape, size_t list, size_t elemIdx);
+
+/**
+ * @brief Get the index just past the subtree of an expression.
+ * For an element of a list this is its next sibling; the first element of
+ * a list is at the index after the list.
+ * @param tape tape to query
+ * @param idx index of the expression
+ * @returns index following the expression
+ */
+size_t sexiTapeNext(SexiTape tape, size_t idx);
+
+/**
+ * @brief Get the string of an id, string, number or empty expression on a tape.
+ * @param tape tape to query
+ * @param idx index of the expression
+ * @returns the string or a `NULL` string of 0 length for lists
+ */
+SexiStr sexiTapeStr(SexiTape tape, size_t idx);
+
+/**
+ * @brief Write a tape into a buffer as a snapshot.
+ *
+ * A snapshot holds the entries of the tape and the bytes of its strings
+ * behind a versioned header, without any pointers, so it can be loaded by
+ * mapping it into memory. Snapshots are only readable on machines with the
+ * byte order of the writer. The error of a tape is not saved.
+ *
+ * Nothing is written unless the whole snapshot fits, so a \p cap of 0
+ * measures it.
+ * @param tape tape to write
+ * @param buf buffer to write into, may be `NULL` if \p cap is 0
+ * @param cap size of \p buf
+ * @returns size of the snapshot
+ */
+size_t sexiTapeSnapshot(SexiTape tape, void *buf, size_t cap);
+
+/**
+ * @brief Write a tape to a file as a snapshot, see \ref sexiTapeSnapshot .
+ * @param tape tape to write
+ * @param path path of the file to create or overwrite
+ * @returns whether the whole snapshot was written
+ */
+bool sexiTapeWriteSnapshot(SexiTape tape, const char *path);
+
+/**
+ * @brief Load a snapshot written by \ref sexiTapeWriteSnapshot .
+ * The file is memory-mapped and queried in place; loading only checks that
+ * every entry is in bounds and every list has the elements it claims.
+ * @param path path of the snapshot
+ * @returns newly created tape, containing an error if the file couldn't be read or isn't a valid snapshot
+ * @see sexiDestroyTape
+ */
+SexiTape sexiTapeLoadSnapshot(const char *path);
+
+/**
+ * @brief Use a snapshot in memory as a tape, checking it like \ref sexiTapeLoadSnapshot .
+ * @param len size of the snapshot
+ * @param ptr pointer to the snapshot, aligned to 8 bytes and outliving the tape
+ * @returns newly created tape, containing an error if the snapshot is invalid
+ * @see sexiDestroyTape
+ */
+SexiTape sexiTapeFromSnapshot(size_t len, const void *ptr);
+
+#ifdef __cplusplus
+}
+
+#include <string>
+#include <string_view>
+
+namespace sexi{
+	class Tape;
+
+	/**
+	 * @brief Non-owning handle to an expression on a \ref Tape .
+	 */
+	class TapeExpr{
+		public:
+			class Iter{
+				public:
+					Iter &operator++() noexcept{
+						m_idx = sexiTapeNext(m_tape, m_idx);
+						return *this;
+					}
+
+					bool operator==(const Iter &other) const noexcept{ return m_idx == other.m_idx; }
+					bool operator!=(const Iter &other) const noexcept{ return m_idx != other.m_idx; }
+
+					TapeExpr operator*() const noexcept{ return TapeExpr(m_tape, m_idx); }
+
+				private:
+					Iter(SexiTape tape_, std::size_t idx_) noexcept
+						: m_tape(tape_), m_idx(idx_){}
+
+					SexiTape m_tape;
+					std::size_t m_idx;
+
+					friend class TapeExpr;
+					friend class Tape;
+			};
+
+			TapeExpr(SexiTape tape_, std::size_t idx_) noexcept
+				: m_tape(tape_), m_idx(idx_){}
+
+			std::size_t index() const noexcept{ return m_idx; }
+
+			SexiExprType type() const noexcept{ return sexiTapeType(m_tape, m_idx); }
+
+			std::size_t length() const noexcept{ return sexiTapeLength(m_tape, m_idx); }
+
+			TapeExpr operator[](std::size_t idx) const noexcept{ return TapeExpr(m_tape, sexiTapeAt(m_tape, m_idx, idx)); }
+
+			std::string_view str() const noexcept{
+				auto ret = sexiTapeStr(m_tape, m_idx);
+				return { ret.ptr, ret.len };
+			}
+
+			bool isEmpty() const noexcept{ return type() == SEXI_EMPTY; }
+			bool isList() const noexcept{ return type() == SEXI_LIST; }
+			bool isId() const noexcept{ return type() == SEXI_ID; }
+			bool isStr() const noexcept{ return type() == SEXI_STR; }
+			bool isNum() const noexcept{ return type() == SEXI_NUM; }
+
+			Iter begin() const noexcept{ return Iter(m_tape, isList() ? m_idx + 1 : m_idx); }
+			Iter end() const noexcept{ return Iter(m_tape, isList() ? sexiTapeNext(m_tape, m_idx) : m_idx); }
+
+		private:
+			SexiTape m_tape;
+			std::size_t m_idx;
+	};
+
+	class Tape{
+		public:
+			Tape(Tape &&other) noexcept
+				: m_tape(other.m_tape)
+			{
+				other.m_tape = nullptr;
+			}
+
+			Tape(const Tape&) = delete;
+
+			~Tape(){
+				if(m_tape) sexiDestroyTape(m_tape);
+			}
+
+			Tape &operator=(const Tape&) = delete;
+
+			bool hasError() const noexcept{ return sexiTapeHasError(m_tape); }
+
+			std::string_view error() const noexcept{
+				auto str = sexiTapeError(m_tape);
+				return { str.ptr, str.len };
+			}
+
+			std::size_t size() const noexcept{ return sexiTapeNumExprs(m_tape); }
+
+			const SexiTapeEntry *entries() const noexcept{ return sexiTapeEntries(m_tape); }
+			std::size_t numEntries() const noexcept{ return sexiTapeSize(m_tape); }
+
+			TapeExpr::Iter begin() const noexcept{ return TapeExpr::Iter(m_tape, 0); }
+			TapeExpr::Iter end() const noexcept{ return TapeExpr::Iter(m_tape, sexiTapeSize(m_tape)); }
+
+			SexiTape handle() const noexcept{ return m_tape; }
+
+			bool writeSnapshot(const std::string &path) const{ return sexiTapeWriteSnapshot(m_tape, path.c_str()); }
+
+		private:
+			explicit Tape(SexiTape tape_) noexcept
+				: m_tape(tape_){}
+
+			SexiTape m_tape;
+
+			friend Tape parseTape(std::string_view, const SexiParseOptions*);
+			friend Tape loadTapeSnapshot(const std::string&);
+	};
+
+	inline Tape parseTape(std::string_view src, const SexiParseOptions *opts = nullptr){
+		return Tape(sexiParseTape(src.size(), src.data(), opts));
+	}
+
+	inline Tape loadTapeSnapshot(const std::string &path){
+		return Tape(sexiTapeLoadSnapshot(path.c_str()));
+	}
+}
+#endif // __cplusplus
+
+/**
+ * @}
+ */
+
+#endif // !SEXI_TAPE_H
@@ -0,0 +1,30 @@
+#include <cstdlib>
+
+#include <atomic>
+
+#include "Alloc.hpp"
+
+static void *mallocAlloc(void*, size_t size){ return std::malloc(size); }
+static void *mallocRealloc(void*, void *ptr, size_t size){ return std::realloc(ptr, size); }
+static void mallocFree(void*, void *ptr){ std::free(ptr); }
+
+static const SexiAllocator mallocAllocator = {
+	.alloc = mallocAlloc,
+	.realloc = mallocRealloc,
+	.free = mallocFree,
+	.userdata = nullptr,
+};
+
+static std::atomic<const SexiAllocator*> defaultAlloc(&mallocAllocator);
+
+const SexiAllocator *sexi::detail::defaultAllocator() noexcept{
+	return defaultAlloc.load(std::memory_order_acquire);
+}
+
+void sexiSetDefaultAllocator(const SexiAllocator *alloc){
+	defaultAlloc.store(alloc ? alloc : &mallocAllocator, std::memory_order_release);
+}
+
+const SexiAllocator *sexiGetDefaultAllocator(){
+	return sexi::detail::defaultAllocator();
+}
@@ -0,0 +1,81 @@
+#ifndef SEXI_ALLOC_HPP
+#define SEXI_ALLOC_HPP 1
+
+#include <cstddef>
+
+#include <new>
+#include <string>
+#include <vector>
+
+#include "sexi/Expr.h"
+
+namespace sexi::detail{
+	/**
+	 * @brief Allocator set by \ref sexiSetDefaultAllocator , or one wrapping `malloc` .
+	 */
+	const SexiAllocator *defaultAllocator() noexcept;
+
+	/**
+	 * @brief \p alloc or the default allocator if it's `nullptr` .
+	 */
+	inline const SexiAllocator *resolveAllocator(const SexiAllocator *alloc) noexcept{
+		return alloc ? alloc : defaultAllocator();
+	}
+
+	inline void *allocate(const SexiAllocator *alloc, std::size_t size) noexcept{
+		return alloc->alloc(alloc->userdata, size);
+	}
+
+	inline void *reallocate(const SexiAllocator *alloc, void *ptr, std::size_t size) noexcept{
+		return alloc->realloc(alloc->userdata, ptr, size);
+	}
+
+	inline void deallocate(const SexiAllocator *alloc, void *ptr) noexcept{
+		if(ptr) alloc->free(alloc->userdata, ptr);
+	}
+
+	/**
+	 * @brief Standard library allocator that goes through a \ref SexiAllocator .
+	 */
+	template<typename T>
+	class StlAllocator{
+		public:
+			using value_type = T;
+
+			StlAllocator() noexcept
+				: m_alloc(defaultAllocator()){}
+
+			explicit StlAllocator(const SexiAllocator *alloc) noexcept
+				: m_alloc(resolveAllocator(alloc)){}
+
+			template<typename U>
+			StlAllocator(const StlAllocator<U> &other) noexcept
+				: m_alloc(other.get()){}
+
+			T *allocate(std::size_t n){
+				auto ret = sexi::detail::allocate(m_alloc, sizeof(T) * n);
+				if(!ret) throw std::bad_alloc();
+				return static_cast<T*>(ret);
+			}
+
+			void deallocate(T *ptr, std::size_t) noexcept{ sexi::detail::deallocate(m_alloc, ptr); }
+
+			const SexiAllocator *get() const noexcept{ return m_alloc; }
+
+			template<typename U>
+			bool operator==(const StlAllocator<U> &other) const noexcept{ return m_alloc == other.get(); }
+
+			template<typename U>
+			bool operator!=(const StlAllocator<U> &other) const noexcept{ return m_alloc != other.get(); }
+
+		private:
+			const SexiAllocator *m_alloc;
+	};
+
+	template<typename T>
+	using Vector = std::vector<T, StlAllocator<T>>;
+
+	using String = std::basic_string<char, std::char_traits<char>, StlAllocator<char>>;
+}
+
+#endif // !SEXI_ALLOC_HPP
@@ -0,0 +1,183 @@
+#ifndef SEXI_ARENA_HPP
+#define SEXI_ARENA_HPP 1
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Alloc.hpp"
+
+namespace sexi::detail{
+	/**
+	 * @brief Bump allocator that releases all of its memory at once.
+	 *
+	 * Blocks start small and double in size up to \ref maxBlockSize , so tiny
+	 * parses stay cheap and large parses only touch the system allocator a
+	 * handful of times. Blocks come from a \ref SexiAllocator , the default
+	 * one unless another is given.
+	 */
+	class Arena{
+		public:
+			static constexpr std::size_t minBlockSize = 4 * 1024;
+			static constexpr std::size_t maxBlockSize = 1024 * 1024;
+
+			Arena() noexcept
+				: Arena(nullptr){}
+
+			explicit Arena(const SexiAllocator *alloc) noexcept
+				: m_alloc(resolveAllocator(alloc)), m_head(nullptr), m_ptr(nullptr), m_end(nullptr), m_nextSize(minBlockSize), m_numBlocks(0), m_numBytes(0){}
+
+			Arena(const Arena&) = delete;
+
+			Arena(Arena &&other) noexcept
+				: m_alloc(other.m_alloc), m_head(other.m_head), m_ptr(other.m_ptr), m_end(other.m_end)
+				, m_nextSize(other.m_nextSize), m_numBlocks(other.m_numBlocks), m_numBytes(other.m_numBytes)
+			{
+				other.m_head = nullptr;
+				other.m_ptr = other.m_end = nullptr;
+				other.m_nextSize = minBlockSize;
+				other.m_numBlocks = other.m_numBytes = 0;
+			}
+
+			~Arena(){ release(); }
+
+			Arena &operator=(const Arena&) = delete;
+
+			void release() noexcept{
+				auto block = m_head;
+				while(block){
+					auto prev = block->prev;
+					deallocate(m_alloc, block);
+					block = prev;
+				}
+
+				m_head = nullptr;
+				m_ptr = m_end = nullptr;
+				m_nextSize = minBlockSize;
+				m_numBlocks = m_numBytes = 0;
+			}
+
+			/**
+			 * @brief Release everything and take later blocks from \p alloc , or the default allocator if it's `nullptr` .
+			 */
+			void setAllocator(const SexiAllocator *alloc) noexcept{
+				release();
+				m_alloc = resolveAllocator(alloc);
+			}
+
+			const SexiAllocator *allocator() const noexcept{ return m_alloc; }
+
+			/**
+			 * @brief Free every block but the newest, which is the largest, and start refilling it.
+			 */
+			void reset() noexcept{
+				if(!m_head) return;
+
+				auto block = m_head->prev;
+				while(block){
+					auto prev = block->prev;
+					--m_numBlocks;
+					m_numBytes -= block->size;
+					deallocate(m_alloc, block);
+					block = prev;
+				}
+
+				m_head->prev = nullptr;
+				m_ptr = reinterpret_cast<char*>(m_head + 1);
+			}
+
+			void *alloc(std::size_t size, std::size_t align = alignof(std::max_align_t)) noexcept{
+				auto p = alignUp(m_ptr, align);
+				if(!m_ptr || p + size > m_end){
+					p = allocSlow(size, align);
+					if(!p) return nullptr;
+				}
+				else{
+					m_ptr = p + size;
+				}
+
+				return p;
+			}
+
+			template<typename T>
+			T *allocArray(std::size_t n) noexcept{
+				return static_cast<T*>(alloc(sizeof(T) * n, alignof(T)));
+			}
+
+			/**
+			 * @brief Copy a string into the arena, null-terminating the copy.
+			 */
+			char *copyStr(const char *ptr, std::size_t len) noexcept{
+				auto ret = static_cast<char*>(alloc(len + 1, 1));
+				if(!ret) return nullptr;
+				std::memcpy(ret, ptr, len);
+				ret[len] = '\0';
+				return ret;
+			}
+
+			std::size_t numBlocks() const noexcept{ return m_numBlocks; }
+			std::size_t numBytes() const noexcept{ return m_numBytes; }
+
+		private:
+			struct Block{
+				Block *prev;
+				std::size_t size;
+			};
+
+			static char *alignUp(char *p, std::size_t align) noexcept{
+				auto addr = reinterpret_cast<std::uintptr_t>(p);
+				return p + ((align - (addr % align)) % align);
+			}
+
+			char *allocSlow(std::size_t size, std::size_t align) noexcept{
+				auto needed = sizeof(Block) + size + align;
+
+				// oversized requests get a dedicated block so the current one keeps filling
+				if(needed > m_nextSize / 2 && m_head){
+					auto block = newBlock(needed);
+					if(!block) return nullptr;
+
+					block->prev = m_head->prev;
+					m_head->prev = block;
+
+					return alignUp(reinterpret_cast<char*>(block + 1), align);
+				}
+
+				auto blockSize = m_nextSize;
+				while(blockSize < needed) blockSize *= 2;
+
+				auto block = newBlock(blockSize);
+				if(!block) return nullptr;
+
+				block->prev = m_head;
+				m_head = block;
+
+				if(m_nextSize < maxBlockSize) m_nextSize *= 2;
+
+				auto p = alignUp(reinterpret_cast<char*>(block + 1), align);
+				m_ptr = p + size;
+				m_end = reinterpret_cast<char*>(block) + blockSize;
+				return p;
+			}
+
+			Block *newBlock(std::size_t size) noexcept{
+				auto block = static_cast<Block*>(allocate(m_alloc, size));
+				if(!block) return nullptr;
+
+				block->size = size;
+
+				++m_numBlocks;
+				m_numBytes += size;
+
+				return block;
+			}
+
+			const SexiAllocator *m_alloc;
+			Block *m_head;
+			char *m_ptr, *m_end;
+			std::size_t m_nextSize;
+			std::size_t m_numBlocks, m_numBytes;
+	};
+}
+
+#endif // !SEXI_ARENA_HPP
@@ -0,0 +1,362 @@
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "sexi/Binary.h"
+
+#include "parse.hpp"
+#include "Pool.hpp"
+
+using namespace sexi::detail;
+
+static constexpr unsigned char binaryMagic[] = { 'S', 'X', 'B', 1 };
+
+// counts up to this fit in the tag byte, the next value marks a varint
+static constexpr std::uint64_t maxInlineCount = 30;
+static constexpr unsigned char varintCount = 31;
+
+namespace {
+	// copies as much as fits, counting everything
+	class BinaryOut{
+		public:
+			BinaryOut(void *buf, std::size_t cap) noexcept
+				: m_buf(static_cast<unsigned char*>(buf)), m_cap(cap), m_len(0){}
+
+			std::size_t size() const noexcept{ return m_len; }
+
+			void put(const void *ptr, std::size_t n) noexcept{
+				if(m_len < m_cap){
+					auto room = m_cap - m_len;
+					std::memcpy(m_buf + m_len, ptr, n < room ? n : room);
+				}
+
+				m_len += n;
+			}
+
+			void tag(SexiBinaryTag tag, std::uint64_t count) noexcept{
+				unsigned char bytes[11];
+				std::size_t n = 1;
+
+				if(count <= maxInlineCount){
+					bytes[0] = static_cast<unsigned char>(tag | (count << 3));
+				}
+				else{
+					bytes[0] = static_cast<unsigned char>(tag | (varintCount << 3));
+
+					while(count >= 0x80){
+						bytes[n++] = static_cast<unsigned char>(count | 0x80);
+						count >>= 7;
+					}
+
+					bytes[n++] = static_cast<unsigned char>(count);
+				}
+
+				put(bytes, n);
+			}
+
+			void text(SexiBinaryTag tag, SexiStr str) noexcept{
+				this->tag(tag, str.len);
+				put(str.ptr, str.len);
+			}
+
+			void float64(double val) noexcept{
+				std::uint64_t bits;
+				std::memcpy(&bits, &val, sizeof(bits));
+
+				unsigned char bytes[8];
+				for(unsigned i = 0; i < 8; i++) bytes[i] = static_cast<unsigned char>(bits >> (i * 8));
+
+				tag(SEXI_BINARY_DOUBLE, 0);
+				put(bytes, sizeof(bytes));
+			}
+
+		private:
+			unsigned char *m_buf;
+			std::size_t m_cap, m_len;
+	};
+
+	// numbers are stored by value only if their text is exactly what the value prints as, so it comes back as it was
+	SexiBinaryTag numTag(SexiExprConst expr) noexcept{
+		char buf[32];
+		std::size_t len = 0;
+		SexiBinaryTag ret;
+
+		switch(expr->numKind){
+			case NumKind::int64:
+				len = std::size_t(std::to_chars(buf, buf + sizeof(buf), expr->num.i).ptr - buf);
+				ret = expr->num.i < 0 ? SEXI_BINARY_SINT : SEXI_BINARY_INT;
+				break;
+
+			case NumKind::uint64:
+				len = std::size_t(std::to_chars(buf, buf + sizeof(buf), expr->num.u).ptr - buf);
+				ret = SEXI_BINARY_INT;
+				break;
+
+			case NumKind::float64:
+				len = formatDouble(expr->num.d, buf);
+				ret = SEXI_BINARY_DOUBLE;
+				break;
+
+			default: return SEXI_BINARY_NUM;
+		}
+
+		return expr->str.len == len && std::memcmp(expr->str.ptr, buf, len) == 0 ? ret : SEXI_BINARY_NUM;
+	}
+
+	// `pending` holds the expressions still to be encoded, popped from the back
+	void encodeExpr(SexiExprConst expr, BinaryOut &out, std::vector<SexiExprConst> &pending){
+		pending.assign(1, expr);
+
+		while(!pending.empty()){
+			expr = pending.back();
+			pending.pop_back();
+
+			switch(expr->type){
+				case SEXI_EMPTY: out.tag(SEXI_BINARY_EMPTY, 0); break;
+
+				case SEXI_LIST:
+					if(!forceList(expr)) throw std::bad_alloc();
+					out.tag(SEXI_BINARY_LIST, expr->list.n);
+					pending.insert(pending.end(), std::make_reverse_iterator(expr->list.exprs + expr->list.n), std::make_reverse_iterator(expr->list.exprs));
+					break;
+
+				case SEXI_ID: out.text(SEXI_BINARY_ID, expr->str); break;
+				case SEXI_STR: out.text(SEXI_BINARY_STR, expr->str); break;
+
+				case SEXI_NUM:
+					switch(numTag(expr)){
+						case SEXI_BINARY_INT: out.tag(SEXI_BINARY_INT, expr->num.u); break;
+						case SEXI_BINARY_SINT: out.tag(SEXI_BINARY_SINT, (std::uint64_t(expr->num.i) << 1) ^ std::uint64_t(expr->num.i >> 63)); break;
+						case SEXI_BINARY_DOUBLE: out.float64(expr->num.d); break;
+						default: out.text(SEXI_BINARY_NUM, expr->str); break;
+					}
+
+					break;
+
+				default: break;
+			}
+		}
+	}
+
+	// rebuilds the tree in one pass, lists are completed once their last element arrives
+	class BinaryDecoder{
+		public:
+			BinaryDecoder(SexiParseResult res, const SexiParseOptions &opts) noexcept
+				: m_res(res), m_opts(opts)
+			{
+				if(opts.pool) m_poolLock = std::unique_lock(opts.pool->mutex);
+			}
+
+			bool decode(const unsigned char *it, const unsigned char *end){
+				if(std::size_t(end - it) < sizeof(binaryMagic) || std::memcmp(it, binaryMagic, sizeof(binaryMagic)) != 0){
+					return error("invalid binary header");
+				}
+
+				it += sizeof(binaryMagic);
+
+				while(it != end){
+					auto tag = SexiBinaryTag(*it & 7);
+					std::uint64_t count = *it >> 3;
+					++it;
+
+					if(count == varintCount && !readVarint(it, end, count)) return false;
+
+					SexiExpr expr = nullptr;
+
+					switch(tag){
+						case SEXI_BINARY_EMPTY:
+						case SEXI_BINARY_LIST:{
+							// empty lists count towards the depth like they do in text
+							if(m_opts.maxDepth && m_frames.size() == m_opts.maxDepth){
+								return error("maximum nesting depth exceeded");
+							}
+
+							if(tag == SEXI_BINARY_EMPTY || count == 0){
+								expr = m_opts.pool ? m_opts.pool->list(0, nullptr) : adoptList(m_res->arena, 0, nullptr);
+								break;
+							}
+
+							m_frames.push_back({ m_elems.size(), count });
+							continue;
+						}
+
+						case SEXI_BINARY_ID:
+						case SEXI_BINARY_STR:
+						case SEXI_BINARY_NUM:{
+							if(count > std::uint64_t(end - it)) return error("unexpected end of binary data");
+
+							SexiStr str = { .len = std::size_t(count), .ptr = reinterpret_cast<const char*>(it) };
+							it += count;
+
+							if(m_opts.pool) expr = poolLeaf(tag, str);
+							else if(tag == SEXI_BINARY_ID && m_opts.symbols) expr = createSymbol(m_res->arena, str, m_opts.symbols, m_symbolCache);
+							else if(tag == SEXI_BINARY_ID) expr = createId(m_res->arena, str, m_opts.copyStrs);
+							else if(tag == SEXI_BINARY_STR) expr = createStr(m_res->arena, str, m_opts.copyStrs);
+							else expr = createNum(m_res->arena, str, m_opts.copyStrs);
+
+							break;
+						}
+
+						case SEXI_BINARY_INT:{
+							NumValue value;
+							value.u = count;
+							expr = num(value, count <= std::uint64_t(INT64_MAX) ? NumKind::int64 : NumKind::uint64);
+							break;
+						}
+
+						case SEXI_BINARY_SINT:{
+							NumValue value;
+							value.i = std::int64_t((count >> 1) ^ (0 - (count & 1)));
+							expr = num(value, NumKind::int64);
+							break;
+						}
+
+						case SEXI_BINARY_DOUBLE:{
+							if(count != 0) return error("invalid tag in binary data");
+							if(end - it < 8) return error("unexpected end of binary data");
+
+							std::uint64_t bits = 0;
+							for(unsigned i = 0; i < 8; i++) bits |= std::uint64_t(it[i]) << (i * 8);
+							it += 8;
+
+							NumValue value;
+							std::memcpy(&value.d, &bits, sizeof(bits));
+							expr = num(value, std::isnan(value.d) ? NumKind::invalid : std::isinf(value.d) ? NumKind::outOfRange : NumKind::float64);
+							break;
+						}
+
+						default: return error("invalid tag in binary data");
+					}
+
+					if(!push(expr)) return false;
+				}
+
+				if(!m_frames.empty()) return error("unexpected end of binary data");
+
+				return true;
+			}
+
+		private:
+			struct Frame{
+				std::size_t elemsBase;
+				std::uint64_t remaining;
+			};
+
+			bool error(std::string_view msg){
+				m_res->hasError = true;
+				m_res->err = msg;
+				return false;
+			}
+
+			// numbers stored by value get back the text they had, and keep the value without reading it again
+			SexiExpr num(NumValue value, NumKind kind){
+				char buf[32];
+				std::size_t len;
+
+				if(kind == NumKind::int64) len = std::size_t(std::to_chars(buf, buf + sizeof(buf), value.i).ptr - buf);
+				else if(kind == NumKind::uint64) len = std::size_t(std::to_chars(buf, buf + sizeof(buf), value.u).ptr - buf);
+				else len = formatDouble(value.d, buf);
+
+				SexiStr str = { .len = len, .ptr = buf };
+				return m_opts.pool ? poolLeaf(SEXI_BINARY_NUM, str) : createNumValue(m_res->arena, str, kind, value);
+			}
+
+			SexiExpr poolLeaf(SexiBinaryTag tag, SexiStr str){
+				if(tag == SEXI_BINARY_STR) return m_opts.pool->leaf(SEXI_STR, str, SEXI_NO_SYMBOL);
+				if(tag == SEXI_BINARY_NUM) return m_opts.pool->leaf(SEXI_NUM, str, SEXI_NO_SYMBOL);
+
+				auto interned = str;
+				auto sym = m_opts.symbols ? m_symbolCache.intern(m_opts.symbols, str, interned) : SEXI_NO_SYMBOL;
+
+				return m_opts.pool->leaf(SEXI_ID, interned, sym);
+			}
+
+			bool readVarint(const unsigned char *&it, const unsigned char *end, std::uint64_t &value){
+				value = 0;
+
+				for(unsigned shift = 0; shift < 64; shift += 7){
+					if(it == end) return error("unexpected end of binary data");
+
+					auto byte = *it++;
+					value |= std::uint64_t(byte & 0x7f) << shift;
+
+					if(!(byte & 0x80)) return true;
+				}
+
+				return error("invalid varint in binary data");
+			}
+
+			// add a finished expression to its list, finishing every list it completes
+			bool push(SexiExpr expr){
+				while(true){
+					if(!expr) return error("failed to allocate expression");
+
+					if(m_frames.empty()){
+						m_res->exprs.emplace_back(expr);
+						return true;
+					}
+
+					m_elems.emplace_back(expr);
+
+					auto &frame = m_frames.back();
+					if(--frame.remaining) return true;
+
+					auto n = m_elems.size() - frame.elemsBase;
+					expr = m_opts.pool ? m_opts.pool->list(n, m_elems.data() + frame.elemsBase) : adoptList(m_res->arena, n, m_elems.data() + frame.elemsBase);
+					m_elems.resize(frame.elemsBase);
+					m_frames.pop_back();
+				}
+			}
+
+			SexiParseResult m_res;
+			const SexiParseOptions &m_opts;
+			std::vector<SexiExpr> m_elems; // elements of every open list
+			std::vector<Frame> m_frames;
+			SymbolCache m_symbolCache;
+			std::unique_lock<std::mutex> m_poolLock; // held until decoding is done
+	};
+}
+
+size_t sexiEncodeBinary(size_t n, const SexiExprConst *exprs, void *buf, size_t cap){
+	BinaryOut out(buf, cap);
+	out.put(binaryMagic, sizeof(binaryMagic));
+
+	try{
+		std::vector<SexiExprConst> pending;
+		for(std::size_t i = 0; i < n; i++){
+			encodeExpr(exprs[i], out, pending);
+		}
+	}
+	catch(const std::bad_alloc&){
+		return 0;
+	}
+
+	return out.size();
+}
+
+SexiParseResult sexiDecodeBinary(size_t len, const void *ptr, const SexiParseOptions *opts){
+	const auto &decodeOpts = opts ? *opts : defaultParseOpts;
+
+	auto ret = createParseResult(decodeOpts);
+	if(!ret) return nullptr;
+
+	auto beg = static_cast<const unsigned char*>(ptr);
+
+	try{
+		BinaryDecoder decoder(ret, decodeOpts);
+		decoder.decode(beg, beg + len);
+	}
+	catch(const std::bad_alloc&){
+		ret->hasError = true;
+		ret->err = "failed to allocate memory";
+	}
+
+	return ret;
+}
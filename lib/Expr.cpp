@@ -1,29 +1,37 @@
+#include <algorithm>
 #include <cassert>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 
-#include <string>
+#include <iterator>
 #include <memory>
+#include <vector>
 
-#include "sexi/Expr.h"
+#include "Expr.hpp"
+#include "Alloc.hpp"
 
 using namespace sexi;
 
-struct SexiExprT{
-	SexiExprType type;
-	union {
-		SexiStr str;
-		struct {
-			size_t n;
-			SexiExpr *exprs;
-		} list;
-	};
-	SexiOwnedStr ownedStr;
+using sexi::detail::Arena;
+using sexi::detail::NumKind;
+
+// longest decimal that always fits in 64 bits
+static constexpr std::ptrdiff_t maxIntDigits = 19;
+
+// every power of ten a double holds exactly
+static constexpr double exactPowersOf10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
 };
 
 std::vector<Expr> Expr::toList() const noexcept{
 	if(!isList()) return { *this };
 
+	if(!detail::forceList(m_expr)) return {};
+
 	std::vector<Expr> ret;
 	ret.reserve(m_expr->list.n);
 
@@ -34,63 +42,137 @@ std::vector<Expr> Expr::toList() const noexcept{
 	return ret;
 }
 
+namespace {
+	// expressions created by the sexiCreate functions are preceded by the allocator they came from
+	struct HeapHeader{
+		const SexiAllocator *alloc;
+	};
+
+	static_assert(sizeof(HeapHeader) % alignof(SexiExprT) == 0);
+
+	inline const SexiAllocator *exprAllocator(SexiExprConst expr) noexcept{
+		assert(expr->onHeap);
+		return reinterpret_cast<const HeapHeader*>(expr)[-1].alloc;
+	}
+
+	// `extra` bytes are left after the expression for whatever it wants to keep inline
+	SexiExpr allocExpr(SexiExprType type, const SexiAllocator *alloc, std::size_t extra = 0) noexcept{
+		alloc = detail::resolveAllocator(alloc);
+
+		auto mem = detail::allocate(alloc, sizeof(HeapHeader) + sizeof(SexiExprT) + extra);
+		if(!mem) return nullptr;
+
+		auto header = new(mem) HeapHeader{ alloc };
+
+		auto ret = new(header + 1) SexiExprT;
+		ret->type = type;
+		ret->ownsStr = false;
+		ret->numKind = detail::NumKind::invalid;
+		ret->listGrown = false;
+		ret->onHeap = true;
+		ret->lazy = detail::lazyNone;
+		ret->list.n = 0;
+		ret->list.exprs = nullptr;
+		ret->num.u = 0;
+		return ret;
+	}
+
+	// number whose text lives in the same allocation, right after the expression
+	SexiExpr allocNumExpr(const char *text, std::size_t len, NumKind kind, detail::NumValue value, const SexiAllocator *alloc) noexcept{
+		auto ret = allocExpr(SEXI_NUM, alloc, len + 1);
+		if(!ret) return nullptr;
+
+		auto chars = reinterpret_cast<char*>(ret + 1);
+
+		std::memcpy(chars, text, len);
+		chars[len] = '\0';
+
+		ret->numKind = kind;
+		ret->str = { .len = len, .ptr = chars };
+		ret->num = value;
+		return ret;
+	}
+}
+
 void sexiDestroyExpr(SexiExpr expr){
+	auto alloc = exprAllocator(expr);
+
 	if(sexiExprIsList(expr)){
-		std::free(expr->list.exprs);
+		// elements are always clones owned by the list
+		for(std::size_t i = 0; i < expr->list.n; i++){
+			sexiDestroyExpr(expr->list.exprs[i]);
+		}
+
+		detail::deallocate(alloc, expr->list.exprs);
 	}
-	else if(expr->ownedStr.ptr){
-		std::free(expr->ownedStr.ptr);
+
+	if(expr->ownsStr){
+		detail::deallocate(alloc, const_cast<char*>(expr->str.ptr));
 	}
 
 	std::destroy_at(expr);
-	std::free(expr);
-}
-
-static inline SexiExpr allocExpr(SexiExprType type){
-	auto mem = std::malloc(sizeof(SexiExprT));
-	if(!mem) return nullptr;
-	auto ret = new(mem) SexiExprT;
-	ret->type = type;
-	ret->ownedStr.len = 0;
-	ret->ownedStr.ptr = nullptr;
-	ret->list.n = 0;
-	ret->list.exprs = nullptr;
-	return ret;
+	detail::deallocate(alloc, reinterpret_cast<HeapHeader*>(expr) - 1);
 }
 
-SexiExpr sexiCreateEmpty(){
-	auto ret = allocExpr(SEXI_EMPTY);
-	ret->str = { .len = 2, .ptr = "()" };
+SexiExpr sexiCreateEmptyEx(const SexiAllocator *alloc){
+	auto ret = allocExpr(SEXI_EMPTY, alloc);
+	if(ret) ret->str = { .len = 2, .ptr = "()" };
 	return ret;
 }
 
-SexiExpr sexiCloneExpr(SexiExprConst expr){
+SexiExpr sexiCloneExprEx(SexiExprConst expr, const SexiAllocator *alloc){
 	if(!expr) return nullptr;
 
 	if(sexiExprIsList(expr)){
-		return sexiCreateList(expr->list.n, expr->list.exprs);
+		if(!detail::forceList(expr)) return nullptr;
+		return sexiCreateListEx(expr->list.n, expr->list.exprs, alloc);
 	}
 
-	auto ret = allocExpr(expr->type);
+	auto ret = allocExpr(expr->type, alloc);
+	if(!ret) return nullptr;
+
 	ret->str = expr->str;
 
+	if(expr->type == SEXI_ID){
+		ret->symbol = expr->symbol;
+	}
+	else{
+		ret->numKind = expr->numKind;
+		ret->num = expr->num;
+	}
+
+	// a clone must never reference the text of the original
 	sexiExprOwnString(ret);
+	if(ret->type != SEXI_EMPTY && !ret->ownsStr){
+		sexiDestroyExpr(ret);
+		return nullptr;
+	}
 
 	return ret;
 }
 
-SexiExpr sexiCreateList(size_t n, const SexiExprConst *exprs){
-	if(n == 0) return sexiCreateEmpty();
+SexiExpr sexiCreateListEx(size_t n, const SexiExprConst *exprs, const SexiAllocator *alloc){
+	if(n == 0) return sexiCreateEmptyEx(alloc);
+
+	auto ret = allocExpr(SEXI_LIST, alloc);
+	if(!ret) return nullptr;
 
-	auto ret = allocExpr(SEXI_LIST);
+	alloc = exprAllocator(ret);
 
-	SexiExpr *newList = (SexiExpr*)std::malloc(sizeof(SexiExpr) * n);
+	auto newList = static_cast<SexiExpr*>(detail::allocate(alloc, sizeof(SexiExpr) * n));
+	if(!newList){
+		sexiDestroyExpr(ret);
+		return nullptr;
+	}
 
 	for(std::size_t i = 0; i < n; i++){
-		newList[i] = sexiCloneExpr(exprs[i]);
+		newList[i] = sexiCloneExprEx(exprs[i], alloc);
 
-		if(!sexiExprIsList(newList[i])){
-			sexiExprOwnString(newList[i]);
+		// the list owns the clones made so far, so destroying it frees them
+		if(!newList[i]){
+			ret->list = { .n = i, .exprs = newList };
+			sexiDestroyExpr(ret);
+			return nullptr;
 		}
 	}
 
@@ -98,78 +180,285 @@ SexiExpr sexiCreateList(size_t n, const SexiExprConst *exprs){
 	return ret;
 }
 
-SexiExpr sexiCreateId(SexiStr str){
-	auto ret = allocExpr(SEXI_ID);
+bool sexiExprAppend(SexiExpr list, SexiExpr elem){
+	// the elements would go where the text of anything else is, and only heap expressions know their allocator
+	if((list->type != SEXI_LIST && list->type != SEXI_EMPTY) || !list->onHeap) return false;
+
+	const auto n = list->type == SEXI_LIST ? list->list.n : 0;
+
+	// lists created whole have no spare room, grown ones are full at every power of two
+	if(!list->listGrown || (n & (n - 1)) == 0){
+		std::size_t cap = 1;
+		while(cap <= n) cap *= 2;
+
+		auto exprs = static_cast<SexiExpr*>(detail::reallocate(exprAllocator(list), n ? list->list.exprs : nullptr, sizeof(SexiExpr) * cap));
+		if(!exprs) return false;
+
+		list->list.exprs = exprs;
+		list->listGrown = true;
+	}
+
+	list->type = SEXI_LIST;
+	list->list.exprs[n] = elem;
+	list->list.n = n + 1;
+	return true;
+}
+
+SexiExpr sexiCreateIdEx(SexiStr str, const SexiAllocator *alloc){
+	auto ret = allocExpr(SEXI_ID, alloc);
+	if(!ret) return nullptr;
+
 	ret->str = str;
+	ret->symbol = SEXI_NO_SYMBOL;
+	return ret;
+}
+
+SexiExpr sexiCreateStrEx(SexiStr str, const SexiAllocator *alloc){
+	auto ret = allocExpr(SEXI_STR, alloc);
+	if(ret) ret->str = str;
+	return ret;
+}
+
+SexiExpr sexiCreateNumEx(SexiStr str, const SexiAllocator *alloc){
+	auto ret = allocExpr(SEXI_NUM, alloc);
+	if(ret) detail::setNum(ret, str);
+	return ret;
+}
+
+SexiExpr sexiCreateIntEx(int64_t val, const SexiAllocator *alloc){
+	char buf[24];
+	auto end = std::to_chars(buf, buf + sizeof(buf), val).ptr;
+
+	detail::NumValue value;
+	value.i = val;
+	return allocNumExpr(buf, std::size_t(end - buf), NumKind::int64, value, alloc);
+}
+
+SexiExpr sexiCreateUintEx(uint64_t val, const SexiAllocator *alloc){
+	char buf[24];
+	auto end = std::to_chars(buf, buf + sizeof(buf), val).ptr;
+
+	detail::NumValue value;
+	value.u = val;
+	return allocNumExpr(buf, std::size_t(end - buf), val <= std::uint64_t(INT64_MAX) ? NumKind::int64 : NumKind::uint64, value, alloc);
+}
+
+std::size_t detail::formatDouble(double val, char (&buf)[32]) noexcept{
+	auto res = std::to_chars(buf, buf + sizeof(buf), val, std::chars_format::fixed);
+	if(res.ec != std::errc()){
+		res = std::to_chars(buf, buf + sizeof(buf), val);
+	}
+
+	return std::size_t(res.ptr - buf);
+}
+
+SexiExpr sexiCreateDoubleEx(double val, const SexiAllocator *alloc){
+	char buf[32];
+	auto len = detail::formatDouble(val, buf);
+
+	detail::NumValue value;
+	value.d = val;
+	auto kind = std::isnan(val) ? NumKind::invalid : std::isinf(val) ? NumKind::outOfRange : NumKind::float64;
+	return allocNumExpr(buf, len, kind, value, alloc);
+}
+
+SexiExpr sexiCloneExpr(SexiExprConst expr){ return sexiCloneExprEx(expr, nullptr); }
+SexiExpr sexiCreateEmpty(){ return sexiCreateEmptyEx(nullptr); }
+SexiExpr sexiCreateList(size_t n, const SexiExprConst *exprs){ return sexiCreateListEx(n, exprs, nullptr); }
+SexiExpr sexiCreateId(SexiStr str){ return sexiCreateIdEx(str, nullptr); }
+SexiExpr sexiCreateStr(SexiStr str){ return sexiCreateStrEx(str, nullptr); }
+SexiExpr sexiCreateNum(SexiStr str){ return sexiCreateNumEx(str, nullptr); }
+SexiExpr sexiCreateInt(int64_t val){ return sexiCreateIntEx(val, nullptr); }
+SexiExpr sexiCreateUint(uint64_t val){ return sexiCreateUintEx(val, nullptr); }
+SexiExpr sexiCreateDouble(double val){ return sexiCreateDoubleEx(val, nullptr); }
+
+SexiExpr detail::createExpr(Arena &arena, SexiExprType type) noexcept{
+	auto mem = arena.alloc(sizeof(SexiExprT), alignof(SexiExprT));
+	if(!mem) return nullptr;
+	auto ret = new(mem) SexiExprT;
+	ret->type = type;
+	ret->ownsStr = false;
+	ret->numKind = detail::NumKind::invalid;
+	ret->listGrown = false;
+	ret->onHeap = false;
+	ret->lazy = detail::lazyNone;
+	ret->list.n = 0;
+	ret->list.exprs = nullptr;
+	ret->num.u = 0;
+	return ret;
+}
+
+SexiExpr detail::createLazyList(Arena &arena, SexiStr src, LazyContext *ctx) noexcept{
+	auto ret = createExpr(arena, SEXI_LIST);
+	if(!ret) return nullptr;
+	ret->lazy = lazyPending;
+	ret->str = src;
+	ret->lazyCtx = ctx;
 	return ret;
 }
 
-SexiExpr sexiCreateStr(SexiStr str){
-	auto ret = allocExpr(SEXI_STR);
+static inline SexiExpr createArenaStrExpr(Arena &arena, SexiExprType type, SexiStr str, bool copyStr) noexcept{
+	auto ret = detail::createExpr(arena, type);
+	if(!ret) return nullptr;
+
+	if(copyStr){
+		auto chars = arena.copyStr(str.ptr, str.len);
+		if(!chars) return nullptr;
+		str.ptr = chars;
+	}
+
 	ret->str = str;
 	return ret;
 }
 
-SexiExpr sexiCreateNum(SexiStr str){
-	auto ret = allocExpr(SEXI_NUM);
+SexiExpr detail::createId(Arena &arena, SexiStr str, bool copyStr) noexcept{
+	auto ret = createArenaStrExpr(arena, SEXI_ID, str, copyStr);
+	if(ret) ret->symbol = SEXI_NO_SYMBOL;
+	return ret;
+}
 
-	auto strView = std::string_view(str.ptr, str.len);
+SexiExpr detail::createStr(Arena &arena, SexiStr str, bool copyStr) noexcept{
+	return createArenaStrExpr(arena, SEXI_STR, str, copyStr);
+}
+
+SexiExpr detail::createNum(Arena &arena, SexiStr str, bool copyStr) noexcept{
+	auto ret = createExpr(arena, SEXI_NUM);
+	if(!ret) return nullptr;
 
-	if(strView.find('.') != std::string_view::npos){
-		auto strEnd = strView.find_last_not_of("0");
-		auto numStr = strView.substr(0, strEnd + 1);
+	setNum(ret, str);
 
-		str.len = numStr.size();
+	if(copyStr){
+		auto chars = arena.copyStr(ret->str.ptr, ret->str.len);
+		if(!chars) return nullptr;
+		ret->str.ptr = chars;
 	}
 
-	ret->str = { .len = str.len, .ptr = str.ptr };
 	return ret;
 }
 
-SexiExprType sexiExprType(SexiExprConst expr){ return expr->type; }
+SexiExpr detail::createNumValue(Arena &arena, SexiStr str, NumKind kind, NumValue value) noexcept{
+	auto ret = createExpr(arena, SEXI_NUM);
+	if(!ret) return nullptr;
 
-bool sexiExprIsEmpty(SexiExprConst expr){ return expr->type == SEXI_EMPTY; }
-bool sexiExprIsList(SexiExprConst expr){ return expr->type == SEXI_LIST; }
-bool sexiExprIsId(SexiExprConst expr){ return expr->type == SEXI_ID; }
-bool sexiExprIsStr(SexiExprConst expr){ return expr->type == SEXI_STR; }
-bool sexiExprIsNum(SexiExprConst expr){ return expr->type == SEXI_NUM; }
+	auto chars = arena.copyStr(str.ptr, str.len);
+	if(!chars) return nullptr;
+
+	ret->str = { .len = str.len, .ptr = chars };
+	ret->numKind = kind;
+	ret->num = value;
+	return ret;
+}
+
+void detail::setNum(SexiExpr expr, SexiStr str) noexcept{
+	auto it = str.ptr, end = str.ptr + str.len;
+
+	// leading zeros don't count towards the digits that fit
+	while(it != end && *it == '0') ++it;
+	const auto digitsBeg = it;
+
+	// most numbers are short plain integers, which need nothing but this loop
+	std::uint64_t value = 0;
+	while(it != end && it - digitsBeg < maxIntDigits && std::uint8_t(*it - '0') < 10){
+		value = value * 10 + std::uint64_t(*it - '0');
+		++it;
+	}
+
+	if(it == end){
+		expr->str = str;
+		expr->numKind = value <= std::uint64_t(INT64_MAX) ? NumKind::int64 : NumKind::uint64;
+		expr->num.u = value;
+		return;
+	}
+
+	const char *dot = *it == '.' ? it : static_cast<const char*>(std::memchr(it, '.', std::size_t(end - it)));
+
+	// trailing zeros of a fraction don't change the value, so they're dropped from the text too;
+	// with an exponent they're digits of the exponent
+	const auto hasExp = std::find_if(it, end, [](char c){ return c == 'e' || c == 'E'; }) != end;
+
+	if(dot && !hasExp){
+		while(end[-1] == '0') --end;
+		str.len = std::size_t(end - str.ptr);
+	}
+
+	expr->str = str;
 
-static inline void sexiAllocListStr(SexiExpr list){
-	auto str = sexiExprToStr(list->list.exprs[0]);
-	std::string ret = "(" + std::string(str.ptr, str.len);
+	// short fractions are exact as an integer divided by a power of ten, which rounds correctly
+	if(it == dot){
+		auto fracBeg = ++it;
+		while(it != end && it - digitsBeg <= maxIntDigits && std::uint8_t(*it - '0') < 10){
+			value = value * 10 + std::uint64_t(*it - '0');
+			++it;
+		}
 
-	for(size_t i = 1; i < list->list.n; i++){
-		auto expr = list->list.exprs[i];
-		auto str = sexiExprToStr(expr);
-		ret += " " + std::string(str.ptr, str.len);
+		auto fracDigits = std::size_t(it - fracBeg);
+		if(it == end && value <= (std::uint64_t(1) << 53) && fracDigits < std::size(exactPowersOf10)){
+			expr->numKind = NumKind::float64;
+			expr->num.d = double(value) / exactPowersOf10[fracDigits];
+			return;
+		}
 	}
 
-	ret += ")";
+	auto intRes = std::from_chars(str.ptr, end, expr->num.u);
+	if(intRes.ptr == end){
+		if(intRes.ec == std::errc()){
+			expr->numKind = expr->num.u <= std::uint64_t(INT64_MAX) ? NumKind::int64 : NumKind::uint64;
+			return;
+		}
+	}
 
-	auto chars = (char*)std::malloc(ret.size() + 1);
-	std::memcpy(chars, ret.data(), ret.size());
-	chars[ret.size()] = '\0';
+	auto res = std::from_chars(str.ptr, end, expr->num.d);
+	if(res.ptr != end){
+		expr->numKind = NumKind::invalid;
+		expr->num.u = 0;
+	}
+	else if(res.ec == std::errc::result_out_of_range){
+		// without an exponent only a fraction starting with many zeros can be too small
+		auto tiny = str.ptr[0] == '0' && !std::memchr(str.ptr, 'e', str.len) && !std::memchr(str.ptr, 'E', str.len);
 
-	list->ownedStr.len = ret.size();
-	list->ownedStr.ptr = chars;
+		expr->numKind = NumKind::outOfRange;
+		expr->num.d = tiny ? 0.0 : HUGE_VAL;
+	}
+	else{
+		expr->numKind = NumKind::float64;
+	}
 }
 
-SexiStr sexiExprToStr(SexiExprConst expr){
-	if(expr->ownedStr.ptr) return sexiRefStr(expr->ownedStr);
+SexiExpr detail::adoptList(Arena &arena, size_t n, const SexiExpr *exprs) noexcept{
+	if(n == 0){
+		auto ret = createExpr(arena, SEXI_EMPTY);
+		if(ret) ret->str = { .len = 2, .ptr = "()" };
+		return ret;
+	}
+
+	auto ret = createExpr(arena, SEXI_LIST);
+	auto newList = arena.allocArray<SexiExpr>(n);
+	if(!ret || !newList) return nullptr;
+
+	std::memcpy(newList, exprs, sizeof(SexiExpr) * n);
+
+	ret->list = { .n = n, .exprs = newList };
+	return ret;
+}
 
+SexiExprType sexiExprType(SexiExprConst expr){ return expr->type; }
+
+bool sexiExprIsEmpty(SexiExprConst expr){ return expr->type == SEXI_EMPTY; }
+bool sexiExprIsList(SexiExprConst expr){ return expr->type == SEXI_LIST; }
+bool sexiExprIsId(SexiExprConst expr){ return expr->type == SEXI_ID; }
+bool sexiExprIsStr(SexiExprConst expr){ return expr->type == SEXI_STR; }
+bool sexiExprIsNum(SexiExprConst expr){ return expr->type == SEXI_NUM; }
+
+SexiStr sexiExprToStr(SexiExprConst expr){
 	switch(expr->type){
 		case SEXI_ID:
 		case SEXI_STR:
 		case SEXI_NUM:
 			return expr->str;
 
-		case SEXI_LIST:{
-			// TODO: create work-around const_cast
-			// possibly allocate string on creation
-			sexiAllocListStr(const_cast<SexiExpr>(expr)); // ewww const_cast
-
-			return sexiRefStr(expr->ownedStr);
-		}
+		// lists have no text of their own, see sexiExprWrite
+		case SEXI_LIST:
+			return { .len = 0, .ptr = nullptr };
 
 		case SEXI_EMPTY:{
 			static constexpr char emptyStr[] = "()";
@@ -184,27 +473,114 @@ SexiStr sexiExprToStr(SexiExprConst expr){
 
 size_t sexiExprLength(SexiExprConst expr){
 	switch(expr->type){
-		case SEXI_LIST: return expr->list.n;
+		case SEXI_LIST:{
+			auto list = detail::forceList(expr);
+			return list ? list->list.n : 0;
+		}
 		case SEXI_EMPTY: return 0;
 		default: return 1;
 	}
 }
 
+SexiNumStatus sexiExprAsInt(SexiExprConst expr, int64_t *out){
+	if(expr->type != SEXI_NUM) return SEXI_NUM_INVALID;
+
+	switch(expr->numKind){
+		case NumKind::int64:
+			*out = expr->num.i;
+			return SEXI_NUM_OK;
+
+		case NumKind::uint64:
+			*out = INT64_MAX;
+			return SEXI_NUM_OUT_OF_RANGE;
+
+		case NumKind::float64:{
+			auto d = expr->num.d;
+
+			// 2^63 is the first double past the end of the range
+			if(d >= 9223372036854775808.0 || d < -9223372036854775808.0){
+				*out = d < 0 ? INT64_MIN : INT64_MAX;
+				return SEXI_NUM_OUT_OF_RANGE;
+			}
+
+			*out = std::int64_t(d);
+			return double(*out) == d ? SEXI_NUM_OK : SEXI_NUM_NOT_INTEGER;
+		}
+
+		case NumKind::outOfRange:
+			*out = expr->num.d == 0.0 ? 0 : INT64_MAX;
+			return expr->num.d == 0.0 ? SEXI_NUM_NOT_INTEGER : SEXI_NUM_OUT_OF_RANGE;
+
+		default: return SEXI_NUM_INVALID;
+	}
+}
+
+SexiNumStatus sexiExprAsUint(SexiExprConst expr, uint64_t *out){
+	if(expr->type != SEXI_NUM) return SEXI_NUM_INVALID;
+
+	switch(expr->numKind){
+		case NumKind::int64:
+			if(expr->num.i < 0){
+				*out = 0;
+				return SEXI_NUM_OUT_OF_RANGE;
+			}
+
+			*out = std::uint64_t(expr->num.i);
+			return SEXI_NUM_OK;
+
+		case NumKind::uint64:
+			*out = expr->num.u;
+			return SEXI_NUM_OK;
+
+		case NumKind::float64:{
+			auto d = expr->num.d;
+
+			if(d >= 18446744073709551616.0 || d < 0.0){
+				*out = d < 0 ? 0 : UINT64_MAX;
+				return SEXI_NUM_OUT_OF_RANGE;
+			}
+
+			*out = std::uint64_t(d);
+			return double(*out) == d ? SEXI_NUM_OK : SEXI_NUM_NOT_INTEGER;
+		}
+
+		case NumKind::outOfRange:
+			*out = expr->num.d == 0.0 ? 0 : UINT64_MAX;
+			return expr->num.d == 0.0 ? SEXI_NUM_NOT_INTEGER : SEXI_NUM_OUT_OF_RANGE;
+
+		default: return SEXI_NUM_INVALID;
+	}
+}
+
+SexiNumStatus sexiExprAsDouble(SexiExprConst expr, double *out){
+	if(expr->type != SEXI_NUM) return SEXI_NUM_INVALID;
+
+	switch(expr->numKind){
+		case NumKind::int64: *out = double(expr->num.i); return SEXI_NUM_OK;
+		case NumKind::uint64: *out = double(expr->num.u); return SEXI_NUM_OK;
+		case NumKind::float64: *out = expr->num.d; return SEXI_NUM_OK;
+		case NumKind::outOfRange: *out = expr->num.d; return SEXI_NUM_OUT_OF_RANGE;
+		default: return SEXI_NUM_INVALID;
+	}
+}
+
 void sexiExprOwnString(SexiExpr expr){
-	if(sexiExprIsEmpty(expr) || expr->ownedStr.ptr) return;
+	// the text of parsed expressions is freed with their result, which copies it already if asked to
+	if(sexiExprIsEmpty(expr) || sexiExprIsList(expr) || expr->ownsStr || !expr->onHeap) return;
 
-	expr->ownedStr.len = expr->str.len;
-	expr->ownedStr.ptr = (char*)std::malloc(expr->str.len + 1);
+	auto chars = static_cast<char*>(detail::allocate(exprAllocator(expr), expr->str.len + 1));
+	if(!chars) return;
 
-	std::memcpy(expr->ownedStr.ptr, expr->str.ptr, expr->str.len);
-	expr->ownedStr.ptr[expr->str.len] = '\0'; // null terminate string
+	std::memcpy(chars, expr->str.ptr, expr->str.len);
+	chars[expr->str.len] = '\0'; // null terminate string
 
-	expr->str.ptr = expr->ownedStr.ptr;
+	expr->str.ptr = chars;
+	expr->ownsStr = true;
 }
 
 SexiExprConst sexiExprAt(SexiExprConst list, size_t idx){
 	switch(list->type){
-		case SEXI_LIST: return list->list.exprs[idx];
+		case SEXI_LIST: return detail::forceList(list) ? list->list.exprs[idx] : nullptr;
 		default: return nullptr;
 	}
 }
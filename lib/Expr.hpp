@@ -0,0 +1,179 @@
+#ifndef SEXI_LIB_EXPR_HPP
+#define SEXI_LIB_EXPR_HPP 1
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "sexi/Expr.h"
+
+#include "Arena.hpp"
+
+namespace sexi::detail{
+	/**
+	 * @brief What the value of a number expression holds.
+	 */
+	enum class NumKind: std::uint8_t{
+		invalid, // not a decimal number, like `12abc`
+		int64,
+		uint64, // too large for `int64`
+		float64,
+		outOfRange, // too large or small for a double, `float64` holds infinity or 0
+	};
+
+	/**
+	 * @brief Whether a list was left unbuilt by a lazy parse, see \ref forceList .
+	 * Stored as a plain byte so it can be loaded and stored atomically.
+	 */
+	enum LazyState: std::uint8_t{
+		lazyNone, // built like any other expression
+		lazyPending, // `str` holds the source text of the list and `lazyCtx` what builds it
+		lazyBuilding, // still pending, but only the thread that claimed it may read `lazyCtx`
+		lazyExpanded, // built on first access, `list` and `hash` are valid
+	};
+
+	struct LazyContext;
+
+	/**
+	 * @brief Value of a number, decoded once when the expression is created.
+	 */
+	union NumValue{
+		std::int64_t i;
+		std::uint64_t u;
+		double d;
+	};
+}
+
+struct SexiExprT{
+	SexiExprType type;
+	bool ownsStr; // `str` was allocated by sexiExprOwnString
+	sexi::detail::NumKind numKind;
+	bool listGrown: 1; // `list.exprs` has room for the next power of two of `list.n` elements, see sexiExprAppend
+	bool onHeap: 1; // created by the sexiCreate functions, anything else lives in an arena
+	std::uint8_t lazy; // a `sexi::detail::LazyState` , only lists of a lazy parse are ever not `lazyNone`
+	union {
+		SexiStr str;
+		struct {
+			size_t n;
+			SexiExpr *exprs;
+		} list;
+	};
+	union {
+		sexi::detail::NumValue num; // numbers
+		std::uint32_t symbol; // ids, `SEXI_NO_SYMBOL` unless interned
+		std::uint64_t hash; // lists, 0 until sexiExprHash caches it
+		sexi::detail::LazyContext *lazyCtx; // lists still `lazyPending` or `lazyBuilding`
+	};
+};
+
+namespace sexi::detail{
+	/**
+	 * @brief Drop trailing zeros after the decimal point of a number without an exponent.
+	 */
+	inline SexiStr trimNumStr(SexiStr str) noexcept{
+		auto strView = std::string_view(str.ptr, str.len);
+
+		if(strView.find('.') != std::string_view::npos && strView.find_first_of("eE") == std::string_view::npos){
+			auto strEnd = strView.find_last_not_of("0");
+			auto numStr = strView.substr(0, strEnd + 1);
+
+			str.len = numStr.size();
+		}
+
+		return { .len = str.len, .ptr = str.ptr };
+	}
+
+	/**
+	 * @brief Trim \p str like \ref trimNumStr and decode its value into \p expr .
+	 */
+	void setNum(SexiExpr expr, SexiStr str) noexcept;
+
+	/**
+	 * @brief Create an expression whose memory is owned by \p arena .
+	 * Arena expressions must never be passed to \ref sexiDestroyExpr .
+	 */
+	SexiExpr createExpr(Arena &arena, SexiExprType type) noexcept;
+
+	SexiExpr createId(Arena &arena, SexiStr str, bool copyStr) noexcept;
+	SexiExpr createStr(Arena &arena, SexiStr str, bool copyStr) noexcept;
+	SexiExpr createNum(Arena &arena, SexiStr str, bool copyStr) noexcept;
+
+	/**
+	 * @brief Create a number from a value decoded already, copying \p str as its text.
+	 */
+	SexiExpr createNumValue(Arena &arena, SexiStr str, NumKind kind, NumValue value) noexcept;
+
+	/**
+	 * @brief Write the shortest text that reads back as \p val , without an exponent unless it's very long.
+	 * @returns length of the text
+	 */
+	std::size_t formatDouble(double val, char (&buf)[32]) noexcept;
+
+	/**
+	 * @brief Create a list that adopts \p exprs as its elements without cloning them.
+	 * Only the pointer array is copied into \p arena ; the elements must outlive the list.
+	 */
+	SexiExpr adoptList(Arena &arena, size_t n, const SexiExpr *exprs) noexcept;
+
+	/**
+	 * @brief Create a list that is only built from \p src , its source text, on first access.
+	 * \p src must hold at least one element and outlive the list.
+	 */
+	SexiExpr createLazyList(Arena &arena, SexiStr src, LazyContext *ctx) noexcept;
+
+	// lazy lists are expanded by whichever thread reads them first
+	inline std::uint8_t loadLazyState(SexiExprConst list) noexcept{
+#ifdef _MSC_VER
+		auto ret = std::uint8_t(__iso_volatile_load8(reinterpret_cast<const volatile char*>(&list->lazy)));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return ret;
+#else
+		return __atomic_load_n(&list->lazy, __ATOMIC_ACQUIRE);
+#endif
+	}
+
+	inline void storeLazyState(SexiExpr list, std::uint8_t state) noexcept{
+#ifdef _MSC_VER
+		std::atomic_thread_fence(std::memory_order_release);
+		__iso_volatile_store8(reinterpret_cast<volatile char*>(&list->lazy), char(state));
+#else
+		__atomic_store_n(&list->lazy, state, __ATOMIC_RELEASE);
+#endif
+	}
+
+	// whoever moves a list from `lazyPending` to `lazyBuilding` is the one that builds it
+	inline bool claimLazyList(SexiExprConst list) noexcept{
+		auto node = const_cast<SexiExpr>(list);
+#ifdef _MSC_VER
+		return _InterlockedCompareExchange8(reinterpret_cast<volatile char*>(&node->lazy), char(lazyBuilding), char(lazyPending)) == char(lazyPending);
+#else
+		std::uint8_t expected = lazyPending;
+		return __atomic_compare_exchange_n(&node->lazy, &expected, std::uint8_t(lazyBuilding), false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE);
+#endif
+	}
+
+	/**
+	 * @brief Build a `lazyPending` list, or wait for the thread building it, see \ref forceList .
+	 * @returns whether the list is built, otherwise it ran out of memory and stays pending
+	 */
+	bool expandList(SexiExprConst list) noexcept;
+
+	/**
+	 * @brief Make sure the elements of \p list are built before reading them.
+	 * Safe to call from several threads at once, only one of them builds the list.
+	 * @returns \p list , or `nullptr` if there was no memory to build it with;
+	 * the next call tries again and the parse result reports the error
+	 */
+	inline SexiExprConst forceList(SexiExprConst list) noexcept{
+		auto state = loadLazyState(list);
+		if((state == lazyPending || state == lazyBuilding) && !expandList(list)) return nullptr;
+		return list;
+	}
+}
+
+#endif // !SEXI_LIB_EXPR_HPP
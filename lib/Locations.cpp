@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <vector>
+
+#include "Locations.hpp"
+#include "Expr.hpp"
+
+using namespace sexi::detail;
+
+namespace {
+	template<typename Bytes>
+	inline void putVarint(Bytes &bytes, std::size_t val){
+		while(val >= 0x80){
+			bytes.push_back((unsigned char)(val | 0x80));
+			val >>= 7;
+		}
+
+		bytes.push_back((unsigned char)val);
+	}
+
+	inline std::size_t getVarint(const unsigned char *&it) noexcept{
+		std::size_t ret = 0;
+		unsigned shift = 0;
+
+		while(*it & 0x80){
+			ret |= std::size_t(*it++ & 0x7f) << shift;
+			shift += 7;
+		}
+
+		return ret | (std::size_t(*it++) << shift);
+	}
+}
+
+bool LocationTable::push(std::size_t offset, std::size_t len) noexcept{
+	const auto end = offset + len;
+
+	try{
+		if(m_checkpoints.empty() || m_size - m_checkpoints.back().idx == checkpointInterval){
+			m_checkpoints.push_back({ .idx = m_size, .bytePos = m_bytes.size(), .prevEnd = m_lastEnd });
+		}
+
+		putVarint(m_bytes, end - m_lastEnd);
+		putVarint(m_bytes, len);
+	}
+	catch(const std::bad_alloc&){
+		return false;
+	}
+
+	m_lastEnd = end;
+	++m_size;
+	return true;
+}
+
+bool LocationTable::append(const LocationTable &other) noexcept{
+	if(!other.m_size) return true;
+
+	try{
+		m_checkpoints.reserve(m_checkpoints.size() + other.m_checkpoints.size());
+
+		// the deltas of `other` start from its own checkpoints, so they carry over as they are
+		for(auto checkpoint : other.m_checkpoints){
+			checkpoint.idx += m_size;
+			checkpoint.bytePos += m_bytes.size();
+			m_checkpoints.push_back(checkpoint);
+		}
+
+		m_bytes.insert(m_bytes.end(), other.m_bytes.begin(), other.m_bytes.end());
+	}
+	catch(const std::bad_alloc&){
+		return false;
+	}
+
+	m_size += other.m_size;
+	m_lastEnd = other.m_lastEnd;
+	return true;
+}
+
+SexiSourceSpan LocationTable::at(std::size_t idx) const noexcept{
+	auto checkpoint = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), idx, [](std::size_t idx, const Checkpoint &checkpoint){
+		return idx < checkpoint.idx;
+	});
+
+	--checkpoint;
+
+	auto it = m_bytes.data() + checkpoint->bytePos;
+	auto end = checkpoint->prevEnd;
+	std::size_t len = 0;
+
+	for(auto i = checkpoint->idx; i <= idx; i++){
+		end += getVarint(it);
+		len = getVarint(it);
+	}
+
+	return { .offset = end - len, .len = len };
+}
+
+bool LocationTable::buildIndex(std::size_t numRoots, const SexiExpr *roots) const noexcept{
+	try{
+		std::vector<std::pair<SexiExprConst, std::size_t>> lists; // open lists and their next element
+		std::size_t idx = 0;
+
+		// number every expression in the order the parse created them, elements before their lists;
+		// lists of a lazy parse were recorded like tokens and aren't looked into, built or not
+		for(std::size_t i = 0; i < numRoots; i++){
+			if(roots[i]->type != SEXI_LIST || loadLazyState(roots[i]) != lazyNone){
+				m_index.emplace_back(roots[i], idx++);
+				continue;
+			}
+
+			lists.emplace_back(roots[i], 0);
+
+			while(!lists.empty()){
+				auto &top = lists.back();
+
+				if(top.second == top.first->list.n){
+					m_index.emplace_back(top.first, idx++);
+					lists.pop_back();
+					continue;
+				}
+
+				auto elem = top.first->list.exprs[top.second++];
+
+				if(elem->type == SEXI_LIST && loadLazyState(elem) == lazyNone){
+					lists.emplace_back(elem, 0);
+				}
+				else{
+					m_index.emplace_back(elem, idx++);
+				}
+			}
+		}
+
+		// spans of an unfinished expression of a failed parse come last, any other mismatch is a bug
+		if(idx > m_size){
+			m_index.clear();
+			return false;
+		}
+
+		std::sort(m_index.begin(), m_index.end(), [](const IndexEntry &lhs, const IndexEntry &rhs){
+			return std::less<SexiExprConst>()(lhs.first, rhs.first);
+		});
+
+		return true;
+	}
+	catch(const std::bad_alloc&){
+		m_index.clear();
+		return false;
+	}
+}
+
+bool LocationTable::find(std::size_t numRoots, const SexiExpr *roots, SexiExprConst expr, SexiSourceSpan &span) const noexcept{
+	if(!m_size) return false;
+
+	std::call_once(m_indexOnce, [&]{ m_indexed = buildIndex(numRoots, roots); });
+	if(!m_indexed) return false;
+
+	auto found = std::lower_bound(m_index.begin(), m_index.end(), expr, [](const IndexEntry &entry, SexiExprConst expr){
+		return std::less<SexiExprConst>()(entry.first, expr);
+	});
+
+	if(found == m_index.end() || found->first != expr) return false;
+
+	span = at(found->second);
+	return true;
+}
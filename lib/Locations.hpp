@@ -0,0 +1,101 @@
+#ifndef SEXI_LOCATIONS_HPP
+#define SEXI_LOCATIONS_HPP 1
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+#include "sexi.h"
+
+#include "Alloc.hpp"
+
+namespace sexi::detail{
+	/**
+	 * @brief Source spans of the expressions of a parse, in the order they were created.
+	 *
+	 * Lists are created after all of their elements, so the ends of the spans
+	 * never decrease. Each span is stored as two varints, the distance from the
+	 * end of the previous span and its length, which takes 2 or 3 bytes for
+	 * most tokens. A checkpoint every \ref checkpointInterval spans bounds the
+	 * decoding needed to get any one of them.
+	 */
+	class LocationTable{
+		public:
+			static constexpr std::size_t checkpointInterval = 64;
+
+			/**
+			 * @brief Size of a table at some point, see \ref truncate .
+			 */
+			struct Mark{
+				std::size_t size, numBytes, numCheckpoints, lastEnd;
+			};
+
+			explicit LocationTable(const SexiAllocator *alloc = nullptr) noexcept
+				: m_bytes(StlAllocator<unsigned char>(alloc)), m_checkpoints(StlAllocator<Checkpoint>(alloc))
+				, m_index(StlAllocator<IndexEntry>(alloc)), m_size(0), m_lastEnd(0){}
+
+			LocationTable(const LocationTable&) = delete;
+
+			LocationTable &operator=(const LocationTable&) = delete;
+
+			std::size_t size() const noexcept{ return m_size; }
+			std::size_t numBytes() const noexcept{ return m_bytes.size() + m_checkpoints.size() * sizeof(Checkpoint); }
+
+			/**
+			 * @brief Add the span of the next expression, which must not end before the last one.
+			 * @returns whether there was memory for it
+			 */
+			bool push(std::size_t offset, std::size_t len) noexcept;
+
+			Mark mark() const noexcept{ return { m_size, m_bytes.size(), m_checkpoints.size(), m_lastEnd }; }
+
+			/**
+			 * @brief Drop every span added since \p mark was taken.
+			 */
+			void truncate(const Mark &mark) noexcept{
+				m_bytes.resize(mark.numBytes);
+				m_checkpoints.resize(mark.numCheckpoints);
+				m_size = mark.size;
+				m_lastEnd = mark.lastEnd;
+			}
+
+			/**
+			 * @brief Add every span of \p other after the ones of this table.
+			 * @returns whether there was memory for them
+			 */
+			bool append(const LocationTable &other) noexcept;
+
+			/**
+			 * @brief Get the span of the expression created \p idx th.
+			 */
+			SexiSourceSpan at(std::size_t idx) const noexcept;
+
+			/**
+			 * @brief Get the span of an expression from the trees the spans were recorded for.
+			 * The first call indexes the expressions of \p roots , which may happen
+			 * concurrently with other calls.
+			 * @returns whether \p expr is one of those expressions
+			 */
+			bool find(std::size_t numRoots, const SexiExpr *roots, SexiExprConst expr, SexiSourceSpan &span) const noexcept;
+
+		private:
+			struct Checkpoint{
+				std::size_t idx; // first span decoded from here
+				std::size_t bytePos;
+				std::size_t prevEnd; // what the first delta is relative to
+			};
+
+			using IndexEntry = std::pair<SexiExprConst, std::size_t>;
+
+			bool buildIndex(std::size_t numRoots, const SexiExpr *roots) const noexcept;
+
+			Vector<unsigned char> m_bytes;
+			Vector<Checkpoint> m_checkpoints;
+			mutable Vector<IndexEntry> m_index; // expressions sorted by address, with their position in creation order
+			mutable std::once_flag m_indexOnce;
+			mutable bool m_indexed = false;
+			std::size_t m_size, m_lastEnd;
+	};
+}
+
+#endif // !SEXI_LOCATIONS_HPP
@@ -0,0 +1,149 @@
+#ifndef SEXI_MAPPEDFILE_HPP
+#define SEXI_MAPPEDFILE_HPP 1
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#define SEXI_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sexi::detail{
+	/**
+	 * @brief Read-only view of a whole file.
+	 *
+	 * Uses a private read-only mapping where available, so the contents are
+	 * served straight from the page cache. Elsewhere, and for pipes, devices
+	 * and anything else that isn't a regular file, it's read into a heap buffer.
+	 */
+	class MappedFile{
+		public:
+			MappedFile() noexcept
+				: m_ptr(nullptr), m_len(0), m_mapped(false){}
+
+			MappedFile(const MappedFile&) = delete;
+
+			~MappedFile(){ close(); }
+
+			MappedFile &operator=(const MappedFile&) = delete;
+
+			/**
+			 * @brief Open and map a file.
+			 * @param path path of the file to open
+			 * @returns empty string on success, otherwise the error message
+			 */
+			std::string_view open(const char *path) noexcept{
+				close();
+
+#ifdef SEXI_HAS_MMAP
+				int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+				if(fd == -1) return "failed to open file";
+
+				struct stat st;
+				if(fstat(fd, &st) != 0){
+					::close(fd);
+					return "failed to stat file";
+				}
+
+				// the size of anything else is meaningless, it has to be read to the end
+				if(!S_ISREG(st.st_mode)){
+					auto file = fdopen(fd, "rb");
+					if(!file){
+						::close(fd);
+						return "failed to open file";
+					}
+
+					auto err = readAll(file);
+					std::fclose(file);
+					return err;
+				}
+
+				m_len = std::size_t(st.st_size);
+
+				if(m_len == 0){
+					::close(fd);
+					return {};
+				}
+
+				auto mem = mmap(nullptr, m_len, PROT_READ, MAP_PRIVATE, fd, 0);
+				::close(fd);
+
+				if(mem == MAP_FAILED){
+					m_len = 0;
+					return "failed to map file";
+				}
+
+#ifdef MADV_SEQUENTIAL
+				madvise(mem, m_len, MADV_SEQUENTIAL);
+#endif
+
+				m_ptr = static_cast<const char*>(mem);
+				m_mapped = true;
+				return {};
+#else
+				auto file = std::fopen(path, "rb");
+				if(!file) return "failed to open file";
+
+				auto err = readAll(file);
+				std::fclose(file);
+				return err;
+#endif
+			}
+
+			void close() noexcept{
+				if(m_ptr){
+#ifdef SEXI_HAS_MMAP
+					if(m_mapped) munmap(const_cast<char*>(m_ptr), m_len);
+#endif
+					if(!m_mapped) std::free(const_cast<char*>(m_ptr));
+				}
+
+				m_ptr = nullptr;
+				m_len = 0;
+				m_mapped = false;
+			}
+
+			const char *data() const noexcept{ return m_ptr; }
+			std::size_t size() const noexcept{ return m_len; }
+
+		private:
+			// reads until the end, growing the buffer as it goes since the size may not be known up front
+			std::string_view readAll(std::FILE *file) noexcept{
+				std::size_t cap = 64 * 1024, len = 0;
+				auto buf = static_cast<char*>(std::malloc(cap));
+
+				while(buf){
+					len += std::fread(buf + len, 1, cap - len, file);
+					if(len < cap) break;
+
+					cap *= 2;
+					auto grown = static_cast<char*>(std::realloc(buf, cap));
+					if(!grown) std::free(buf);
+					buf = grown;
+				}
+
+				if(!buf) return "failed to allocate memory";
+
+				if(std::ferror(file)){
+					std::free(buf);
+					return "failed to read file";
+				}
+
+				m_ptr = buf;
+				m_len = len;
+				return {};
+			}
+
+			const char *m_ptr;
+			std::size_t m_len;
+			bool m_mapped;
+	};
+}
+
+#endif // !SEXI_MAPPEDFILE_HPP
@@ -0,0 +1,248 @@
+#include <cstdlib>
+#include <cstring>
+
+#include <memory>
+#include <new>
+
+#include "Pool.hpp"
+#include "Expr.hpp"
+#include "Symbols.hpp"
+
+using namespace sexi::detail;
+
+// pools start with this many slots and double whenever half of them are used
+static constexpr std::size_t minSlots = 1024;
+
+namespace {
+	inline std::uint64_t mixHash(std::uint64_t h) noexcept{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccd;
+		h ^= h >> 33;
+		return h;
+	}
+
+	inline std::uint64_t hashLeaf(SexiExprType type, SexiStr str, std::uint32_t symbol) noexcept{
+		return mixHash(hashSymbol(str) ^ (std::uint64_t(type) << 56) ^ symbol);
+	}
+
+	// elements are already unique, so their addresses stand in for their contents
+	inline std::uint64_t hashList(std::size_t n, const SexiExprConst *exprs) noexcept{
+		std::uint64_t ret = n;
+		for(std::size_t i = 0; i < n; i++){
+			ret = (ret ^ reinterpret_cast<std::uintptr_t>(exprs[i])) * 0x100000001b3;
+		}
+
+		return mixHash(ret);
+	}
+
+	template<typename Eq>
+	SexiExpr findNode(const SexiExprPoolT &pool, std::uint64_t hash, Eq &&eq) noexcept{
+		if(pool.slots.empty()) return nullptr;
+
+		const auto mask = pool.slots.size() - 1;
+
+		for(auto idx = std::size_t(hash) & mask;; idx = (idx + 1) & mask){
+			auto expr = pool.slots[idx];
+			if(!expr) return nullptr;
+			if(pool.hashes[idx] == hash && eq(expr)) return expr;
+		}
+	}
+
+	SexiExpr findList(const SexiExprPoolT &pool, std::uint64_t hash, std::size_t n, const SexiExprConst *exprs) noexcept{
+		return findNode(pool, hash, [&](SexiExprConst expr){
+			return expr->type == SEXI_LIST && expr->list.n == n && std::memcmp(expr->list.exprs, exprs, sizeof(SexiExprConst) * n) == 0;
+		});
+	}
+
+	// grow before allocating the node, so running out of memory leaves the pool as it was
+	bool reserveSlot(SexiExprPoolT &pool) noexcept{
+		if((pool.size + 1) * 2 <= pool.slots.size()) return true;
+
+		try{
+			const auto numSlots = pool.slots.empty() ? minSlots : pool.slots.size() * 2;
+			std::vector<SexiExpr> newSlots(numSlots, nullptr);
+			std::vector<std::uint64_t> newHashes(numSlots);
+
+			const auto mask = numSlots - 1;
+
+			for(std::size_t i = 0; i < pool.slots.size(); i++){
+				if(!pool.slots[i]) continue;
+
+				auto idx = std::size_t(pool.hashes[i]) & mask;
+				while(newSlots[idx]) idx = (idx + 1) & mask;
+
+				newSlots[idx] = pool.slots[i];
+				newHashes[idx] = pool.hashes[i];
+			}
+
+			pool.slots.swap(newSlots);
+			pool.hashes.swap(newHashes);
+			return true;
+		}
+		catch(const std::bad_alloc&){
+			return false;
+		}
+	}
+
+	SexiExpr insertNode(SexiExprPoolT &pool, std::uint64_t hash, SexiExpr expr) noexcept{
+		if(!expr) return nullptr;
+
+		const auto mask = pool.slots.size() - 1;
+
+		auto idx = std::size_t(hash) & mask;
+		while(pool.slots[idx]) idx = (idx + 1) & mask;
+
+		pool.slots[idx] = expr;
+		pool.hashes[idx] = hash;
+		++pool.size;
+
+		return expr;
+	}
+}
+
+SexiExpr SexiExprPoolT::leaf(SexiExprType type, SexiStr str, std::uint32_t symbol) noexcept{
+	if(type == SEXI_EMPTY) str = { .len = 2, .ptr = "()" };
+	else if(type == SEXI_NUM) str = trimNumStr(str);
+
+	const auto hash = hashLeaf(type, str, symbol);
+
+	auto found = findNode(*this, hash, [&](SexiExprConst expr){
+		return expr->type == type && expr->str.len == str.len && std::memcmp(expr->str.ptr, str.ptr, str.len) == 0
+			&& (type != SEXI_ID || expr->symbol == symbol);
+	});
+
+	if(found) return found;
+	if(!reserveSlot(*this)) return nullptr;
+
+	SexiExpr expr = nullptr;
+
+	switch(type){
+		case SEXI_EMPTY: expr = adoptList(arena, 0, nullptr); break;
+		case SEXI_NUM: expr = createNum(arena, str, true); break;
+		case SEXI_STR: expr = createStr(arena, str, true); break;
+
+		case SEXI_ID:
+			expr = createId(arena, str, true);
+			if(expr) expr->symbol = symbol;
+			break;
+
+		default: break;
+	}
+
+	return insertNode(*this, hash, expr);
+}
+
+SexiExpr SexiExprPoolT::list(std::size_t n, const SexiExprConst *exprs) noexcept{
+	if(n == 0) return leaf(SEXI_EMPTY, {}, SEXI_NO_SYMBOL);
+
+	const auto hash = hashList(n, exprs);
+
+	if(auto found = findList(*this, hash, n, exprs)) return found;
+	if(!reserveSlot(*this)) return nullptr;
+
+	// pooled nodes are never modified, so dropping const from the elements is safe
+	return insertNode(*this, hash, adoptList(arena, n, const_cast<const SexiExpr*>(exprs)));
+}
+
+SexiExpr SexiExprPoolT::intern(SexiExprConst expr) noexcept{
+	struct Frame{
+		SexiExprConst list;
+		std::size_t elemsBase;
+	};
+
+	try{
+		std::vector<SexiExprConst> elems; // pooled elements of every open list
+		std::vector<Frame> frames;
+
+		while(true){
+			SexiExpr node = nullptr;
+
+			if(expr->type == SEXI_LIST){
+				if(!forceList(expr)) return nullptr;
+
+				// a list whose elements are already pooled is found without visiting them
+				node = findList(*this, hashList(expr->list.n, expr->list.exprs), expr->list.n, expr->list.exprs);
+
+				if(!node){
+					frames.push_back({ expr, elems.size() });
+					expr = expr->list.exprs[0];
+					continue;
+				}
+			}
+			else{
+				node = leaf(expr->type, expr->str, expr->type == SEXI_ID ? expr->symbol : SEXI_NO_SYMBOL);
+				if(!node) return nullptr;
+			}
+
+			// finish every list this completes, then move on to the next element
+			while(true){
+				if(frames.empty()) return node;
+
+				elems.push_back(node);
+
+				auto &frame = frames.back();
+				auto numElems = elems.size() - frame.elemsBase;
+
+				if(numElems < frame.list->list.n){
+					expr = frame.list->list.exprs[numElems];
+					break;
+				}
+
+				node = list(numElems, elems.data() + frame.elemsBase);
+				if(!node) return nullptr;
+
+				elems.resize(frame.elemsBase);
+				frames.pop_back();
+			}
+		}
+	}
+	catch(const std::bad_alloc&){
+		return nullptr;
+	}
+}
+
+SexiExprPool sexiCreateExprPool(){
+	auto alloc = defaultAllocator();
+
+	auto mem = allocate(alloc, sizeof(SexiExprPoolT));
+	if(!mem) return nullptr;
+
+	auto ret = new(mem) SexiExprPoolT;
+	ret->arena.setAllocator(alloc);
+	return ret;
+}
+
+void sexiDestroyExprPool(SexiExprPool pool){
+	// the struct came from the same allocator as the arena
+	auto alloc = pool->arena.allocator();
+	std::destroy_at(pool);
+	deallocate(alloc, pool);
+}
+
+SexiExprConst sexiExprPoolIntern(SexiExprPool pool, SexiExprConst expr){
+	std::lock_guard lock(pool->mutex);
+	return pool->intern(expr);
+}
+
+SexiExprConst sexiExprPoolList(SexiExprPool pool, size_t n, const SexiExprConst *exprs){
+	std::lock_guard lock(pool->mutex);
+
+	try{
+		std::vector<SexiExprConst> elems(exprs, exprs + n);
+
+		for(auto &elem : elems){
+			elem = pool->intern(elem);
+			if(!elem) return nullptr;
+		}
+
+		return pool->list(n, elems.data());
+	}
+	catch(const std::bad_alloc&){
+		return nullptr;
+	}
+}
+
+size_t sexiExprPoolSize(SexiExprPool pool){
+	std::lock_guard lock(pool->mutex);
+	return pool->size;
+}
@@ -0,0 +1,40 @@
+#ifndef SEXI_POOL_HPP
+#define SEXI_POOL_HPP 1
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "sexi/Expr.h"
+
+#include "Arena.hpp"
+
+struct SexiExprPoolT{
+	std::mutex mutex; // guards everything below, held for the whole of a parse into the pool
+	sexi::detail::Arena arena; // every node, child array and string of the pool
+	std::vector<SexiExpr> slots; // open addressing over distinct nodes, `nullptr` when empty
+	std::vector<std::uint64_t> hashes; // hash of the node in each slot
+	std::size_t size = 0;
+
+	/**
+	 * @brief Get the node of an id, string, number or empty expression, adding it if it's new.
+	 * Numbers are trimmed like \ref sexi::detail::trimNumStr before comparing.
+	 * @param symbol symbol of an id, `SEXI_NO_SYMBOL` for anything else
+	 * @returns the pool's node or `nullptr` if it couldn't be added
+	 */
+	SexiExpr leaf(SexiExprType type, SexiStr str, std::uint32_t symbol) noexcept;
+
+	/**
+	 * @brief Get the node of a list of nodes of this pool, adding it if it's new.
+	 * @returns the pool's node or `nullptr` if it couldn't be added
+	 */
+	SexiExpr list(std::size_t n, const SexiExprConst *exprs) noexcept;
+
+	/**
+	 * @brief Get the node equal to \p expr , adding it and any of its elements that are new.
+	 * @returns the pool's node or `nullptr` if it couldn't be added
+	 */
+	SexiExpr intern(SexiExprConst expr) noexcept;
+};
+
+#endif // !SEXI_POOL_HPP
@@ -0,0 +1,132 @@
+#include <cstdlib>
+
+#include <memory>
+#include <new>
+
+#include "Symbols.hpp"
+#include "Expr.hpp"
+
+using namespace sexi::detail;
+
+// tables start with this many slots and double whenever half of them are used
+static constexpr std::size_t minSlots = 256;
+
+std::uint32_t SexiSymbolTableT::find(SexiStr str, std::uint64_t hash) noexcept{
+	if(slots.empty()) return SEXI_NO_SYMBOL;
+
+	const auto mask = slots.size() - 1;
+
+	for(auto idx = std::size_t(hash) & mask;; idx = (idx + 1) & mask){
+		auto sym = slots[idx];
+		if(sym == SEXI_NO_SYMBOL) return SEXI_NO_SYMBOL;
+
+		auto &symStr = strs[sym];
+		if(hashes[sym] == hash && symStr.len == str.len && std::memcmp(symStr.ptr, str.ptr, str.len) == 0){
+			return sym;
+		}
+	}
+}
+
+std::uint32_t SexiSymbolTableT::intern(SexiStr str, std::uint64_t hash, SexiStr &interned) noexcept{
+	std::lock_guard lock(mutex);
+
+	auto sym = find(str, hash);
+	if(sym != SEXI_NO_SYMBOL){
+		interned = strs[sym];
+		return sym;
+	}
+
+	if(strs.size() >= SEXI_NO_SYMBOL) return SEXI_NO_SYMBOL;
+
+	// allocate everything up front so running out of memory leaves the table as it was
+	try{
+		if(strs.size() == strs.capacity()) strs.reserve(strs.empty() ? minSlots / 2 : strs.size() * 2);
+		if(hashes.size() == hashes.capacity()) hashes.reserve(strs.capacity());
+
+		if((strs.size() + 1) * 2 > slots.size()){
+			std::vector<std::uint32_t> newSlots(slots.empty() ? minSlots : slots.size() * 2, SEXI_NO_SYMBOL);
+			const auto newMask = newSlots.size() - 1;
+
+			for(std::uint32_t i = 0; i < strs.size(); i++){
+				auto idx = std::size_t(hashes[i]) & newMask;
+				while(newSlots[idx] != SEXI_NO_SYMBOL) idx = (idx + 1) & newMask;
+				newSlots[idx] = i;
+			}
+
+			slots.swap(newSlots);
+		}
+	}
+	catch(const std::bad_alloc&){
+		return SEXI_NO_SYMBOL;
+	}
+
+	auto chars = arena.copyStr(str.ptr, str.len);
+	if(!chars) return SEXI_NO_SYMBOL;
+
+	sym = std::uint32_t(strs.size());
+	strs.push_back({ .len = str.len, .ptr = chars });
+	hashes.push_back(hash);
+
+	const auto mask = slots.size() - 1;
+
+	auto idx = std::size_t(hash) & mask;
+	while(slots[idx] != SEXI_NO_SYMBOL) idx = (idx + 1) & mask;
+	slots[idx] = sym;
+
+	interned = strs[sym];
+	return sym;
+}
+
+SexiExpr sexi::detail::createSymbol(Arena &arena, SexiStr str, SexiSymbolTable table, SymbolCache &cache) noexcept{
+	SexiStr interned;
+	auto sym = cache.intern(table, str, interned);
+
+	// ids that couldn't be interned are still valid, they just have no symbol
+	if(sym == SEXI_NO_SYMBOL) return createId(arena, str, true);
+
+	auto ret = createId(arena, interned, false);
+	if(ret) ret->symbol = sym;
+	return ret;
+}
+
+SexiSymbolTable sexiCreateSymbolTable(){
+	auto alloc = defaultAllocator();
+
+	auto mem = allocate(alloc, sizeof(SexiSymbolTableT));
+	if(!mem) return nullptr;
+
+	auto ret = new(mem) SexiSymbolTableT;
+	ret->arena.setAllocator(alloc);
+	return ret;
+}
+
+void sexiDestroySymbolTable(SexiSymbolTable table){
+	// the struct came from the same allocator as the arena
+	auto alloc = table->arena.allocator();
+	std::destroy_at(table);
+	deallocate(alloc, table);
+}
+
+uint32_t sexiSymbolTableIntern(SexiSymbolTable table, SexiStr str){
+	SexiStr interned;
+	return table->intern(str, hashSymbol(str), interned);
+}
+
+uint32_t sexiSymbolTableFind(SexiSymbolTable table, SexiStr str){
+	std::lock_guard lock(table->mutex);
+	return table->find(str, hashSymbol(str));
+}
+
+size_t sexiSymbolTableSize(SexiSymbolTable table){
+	std::lock_guard lock(table->mutex);
+	return table->strs.size();
+}
+
+SexiStr sexiSymbolTableStr(SexiSymbolTable table, uint32_t sym){
+	std::lock_guard lock(table->mutex);
+	return sym < table->strs.size() ? table->strs[sym] : SexiStr{ .len = 0, .ptr = nullptr };
+}
+
+uint32_t sexiExprSymbol(SexiExprConst expr){
+	return expr->type == SEXI_ID ? expr->symbol : SEXI_NO_SYMBOL;
+}
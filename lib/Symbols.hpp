@@ -0,0 +1,101 @@
+#ifndef SEXI_SYMBOLS_HPP
+#define SEXI_SYMBOLS_HPP 1
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "sexi/Expr.h"
+
+#include "Arena.hpp"
+
+struct SexiSymbolTableT{
+	std::mutex mutex; // guards everything below, tables may be shared by concurrent parses
+	sexi::detail::Arena arena; // copies of the symbol strings, which never move
+	std::vector<SexiStr> strs; // string of each symbol
+	std::vector<std::uint64_t> hashes; // hash of each symbol
+	std::vector<std::uint32_t> slots; // open addressing over symbols, `SEXI_NO_SYMBOL` when empty
+
+	/**
+	 * @brief Get the symbol of \p str , adding it if it's new.
+	 * @param interned set to the table's copy of \p str
+	 * @returns the symbol or `SEXI_NO_SYMBOL` if it couldn't be added
+	 */
+	std::uint32_t intern(SexiStr str, std::uint64_t hash, SexiStr &interned) noexcept;
+
+	/**
+	 * @brief Find the symbol of \p str without adding it.
+	 * @returns the symbol or `SEXI_NO_SYMBOL`
+	 */
+	std::uint32_t find(SexiStr str, std::uint64_t hash) noexcept;
+};
+
+namespace sexi::detail{
+	/**
+	 * @brief FNV-1a, ids are short enough that anything fancier doesn't pay off.
+	 */
+	inline std::uint64_t hashSymbol(SexiStr str) noexcept{
+		std::uint64_t ret = 0xcbf29ce484222325;
+		for(std::size_t i = 0; i < str.len; i++){
+			ret = (ret ^ static_cast<unsigned char>(str.ptr[i])) * 0x100000001b3;
+		}
+
+		return ret;
+	}
+
+	/**
+	 * @brief Recently interned symbols of one parse, so repeated ids don't take the table's lock.
+	 */
+	class SymbolCache{
+		public:
+			static constexpr std::size_t numEntries = 512;
+
+			std::uint32_t intern(SexiSymbolTable table, SexiStr str, SexiStr &interned) noexcept{
+				auto hash = hashSymbol(str);
+
+				if(table != m_table){
+					// without memory for the cache every id goes to the table, the next one tries again
+					try{
+						m_entries.assign(numEntries, { { .len = 0, .ptr = nullptr }, SEXI_NO_SYMBOL });
+					}
+					catch(const std::bad_alloc&){
+						m_table = nullptr;
+						return table->intern(str, hash, interned);
+					}
+
+					m_table = table;
+				}
+				auto &entry = m_entries[hash & (numEntries - 1)];
+
+				if(entry.sym != SEXI_NO_SYMBOL && entry.str.len == str.len && std::memcmp(entry.str.ptr, str.ptr, str.len) == 0){
+					interned = entry.str;
+					return entry.sym;
+				}
+
+				auto sym = table->intern(str, hash, interned);
+				if(sym != SEXI_NO_SYMBOL){
+					entry = { interned, sym };
+				}
+
+				return sym;
+			}
+
+		private:
+			struct Entry{
+				SexiStr str; // the table's copy
+				std::uint32_t sym;
+			};
+
+			SexiSymbolTable m_table = nullptr;
+			std::vector<Entry> m_entries;
+	};
+
+	/**
+	 * @brief Create an id whose memory is owned by \p arena and whose string is owned by \p table .
+	 */
+	SexiExpr createSymbol(Arena &arena, SexiStr str, SexiSymbolTable table, SymbolCache &cache) noexcept;
+}
+
+#endif // !SEXI_SYMBOLS_HPP
@@ -0,0 +1,404 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sexi/Tape.h"
+
+#include "parse.hpp"
+#include "walk.hpp"
+
+using namespace sexi::detail;
+
+struct SexiTapeT{
+	explicit SexiTapeT(const SexiAllocator *alloc) noexcept
+		: alloc(alloc), entries(StlAllocator<SexiTapeEntry>(alloc)), pool(StlAllocator<char>(alloc)){}
+
+	const SexiAllocator *alloc; // allocator of the tape itself, its entries and pool
+	bool hasError;
+	std::string_view err;
+	std::size_t numExprs;
+	Vector<SexiTapeEntry> entries; // entries of a parsed tape
+	String pool; // copied strings when parsing with copyStrs
+	MappedFile file; // snapshot loaded by sexiTapeLoadSnapshot
+	const SexiTapeEntry *entryData; // what the accessors read, `entries` or part of a snapshot
+	std::size_t numEntries;
+	const char *strBase; // what the offsets of strings are relative to
+	std::size_t strSize;
+};
+
+namespace {
+	// start of a snapshot, the entries and strings follow at the given offsets
+	struct SnapshotHeader{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byteOrder; // `snapshotByteOrder` in the byte order of the writer
+		std::uint64_t numExprs;
+		std::uint64_t numEntries;
+		std::uint64_t entriesOff;
+		std::uint64_t strsOff;
+		std::uint64_t strsSize;
+		std::uint64_t reserved;
+	};
+}
+
+static_assert(sizeof(SnapshotHeader) == 64);
+static_assert(sizeof(SexiTapeEntry) == 16);
+
+static constexpr char snapshotMagic[8] = { 'S', 'E', 'X', 'I', 'T', 'A', 'P', 'E' };
+static constexpr std::uint32_t snapshotVersion = 1;
+static constexpr std::uint32_t snapshotByteOrder = 0x01020304;
+
+static constexpr SexiStr emptyListStr = { .len = 2, .ptr = "()" };
+
+namespace {
+	// appends every expression to the tape in pre-order, lists are completed when they close
+	class TapeBuilder{
+		public:
+			TapeBuilder(SexiTape tape, const char *src, bool copyStrs) noexcept
+				: m_tape(tape), m_src(src), m_copyStrs(copyStrs), m_numComplete(0){}
+
+			bool listBegin(const char*){
+				if(!m_lists.empty() && !countElem()) return false;
+
+				m_lists.emplace_back(m_tape->entries.size());
+				m_tape->entries.push_back({ .type = SEXI_LIST, .len = 0, .skip = 0 });
+				return true;
+			}
+
+			bool listEnd(const char*){
+				auto idx = m_lists.back();
+				m_lists.pop_back();
+
+				auto &entry = m_tape->entries[idx];
+				entry.skip = m_tape->entries.size() - idx;
+
+				if(entry.len == 0){
+					entry.type = SEXI_EMPTY;
+				}
+
+				if(m_lists.empty()){
+					++m_tape->numExprs;
+					m_numComplete = m_tape->entries.size();
+				}
+
+				return true;
+			}
+
+			bool id(SexiStr str){ return push(SEXI_ID, str); }
+			bool str(SexiStr str){ return push(SEXI_STR, str); }
+			bool num(SexiStr str){ return push(SEXI_NUM, trimNumStr(str)); }
+
+			void error(std::string_view msg, const char* = nullptr){
+				m_tape->hasError = true;
+				m_tape->err = msg;
+			}
+
+			// drop the entries of an unfinished top-level expression so the tape stays walkable
+			void truncate(){ m_tape->entries.resize(m_numComplete); }
+
+		private:
+			bool countElem(){
+				auto &len = m_tape->entries[m_lists.back()].len;
+				if(len == std::numeric_limits<std::uint32_t>::max()){
+					error("expression too large for tape");
+					return false;
+				}
+
+				++len;
+				return true;
+			}
+
+			bool push(SexiExprType type, SexiStr str){
+				if(str.len > std::numeric_limits<std::uint32_t>::max()){
+					error("expression too large for tape");
+					return false;
+				}
+
+				if(!countElem()) return false;
+
+				std::uint64_t off;
+				if(m_copyStrs){
+					off = m_tape->pool.size();
+					m_tape->pool.append(str.ptr, str.len);
+				}
+				else{
+					off = std::uint64_t(str.ptr - m_src);
+				}
+
+				m_tape->entries.push_back({ .type = std::uint32_t(type), .len = std::uint32_t(str.len), .off = off });
+				return true;
+			}
+
+			SexiTape m_tape;
+			const char *m_src;
+			bool m_copyStrs;
+			std::size_t m_numComplete;
+			std::vector<std::size_t> m_lists; // entries of the open lists
+	};
+}
+
+static SexiTape sexiCreateTape(const SexiAllocator *alloc){
+	alloc = resolveAllocator(alloc);
+
+	auto mem = allocate(alloc, sizeof(SexiTapeT));
+	if(!mem) return nullptr;
+
+	auto ret = new(mem) SexiTapeT(alloc);
+	ret->hasError = false;
+	ret->numExprs = 0;
+	ret->entryData = nullptr;
+	ret->numEntries = 0;
+	ret->strBase = nullptr;
+	ret->strSize = 0;
+	return ret;
+}
+
+static SexiTape sexiTapeFail(SexiTape tape, std::string_view msg){
+	tape->hasError = true;
+	tape->err = msg;
+	return tape;
+}
+
+SexiTape sexiParseTape(size_t len, const char *ptr, const SexiParseOptions *opts){
+	const auto &tapeOpts = opts ? *opts : defaultParseOpts;
+
+	auto ret = sexiCreateTape(tapeOpts.allocator);
+	if(!ret) return nullptr;
+
+	TapeBuilder builder(ret, ptr, tapeOpts.copyStrs);
+
+	try{
+		// typical source needs an entry for every 5 to 10 bytes
+		ret->entries.reserve(len / 8 + 1);
+
+		if(!walkExprs(ptr, ptr + len, tapeOpts.maxDepth, builder)){
+			builder.truncate();
+		}
+
+		// growing can leave up to half the entries unused, which would undo the savings of the layout
+		if(ret->entries.capacity() - ret->entries.size() > ret->entries.size() / 4){
+			ret->entries.shrink_to_fit();
+		}
+	}
+	catch(const std::bad_alloc&){
+		builder.truncate();
+		sexiTapeFail(ret, "failed to allocate memory");
+	}
+
+	ret->entryData = ret->entries.data();
+	ret->numEntries = ret->entries.size();
+	ret->strBase = tapeOpts.copyStrs ? ret->pool.data() : ptr;
+	ret->strSize = tapeOpts.copyStrs ? ret->pool.size() : len;
+
+	return ret;
+}
+
+void sexiDestroyTape(SexiTape tape){
+	auto alloc = tape->alloc;
+	std::destroy_at(tape);
+	deallocate(alloc, tape);
+}
+
+bool sexiTapeHasError(SexiTape tape){ return tape->hasError; }
+SexiStr sexiTapeError(SexiTape tape){ return { .len = tape->err.size(), .ptr = tape->err.data() }; }
+
+size_t sexiTapeNumExprs(SexiTape tape){ return tape->numExprs; }
+size_t sexiTapeSize(SexiTape tape){ return tape->numEntries; }
+
+const SexiTapeEntry *sexiTapeEntries(SexiTape tape){ return tape->numEntries ? tape->entryData : nullptr; }
+const char *sexiTapeStrBase(SexiTape tape){ return tape->strBase; }
+
+SexiExprType sexiTapeType(SexiTape tape, size_t idx){ return SexiExprType(tape->entryData[idx].type); }
+
+size_t sexiTapeLength(SexiTape tape, size_t idx){
+	auto &entry = tape->entryData[idx];
+	switch(entry.type){
+		case SEXI_EMPTY: return 0;
+		case SEXI_LIST: return entry.len;
+		default: return 1;
+	}
+}
+
+size_t sexiTapeAt(SexiTape tape, size_t list, size_t elemIdx){
+	auto idx = list + 1;
+	for(size_t i = 0; i < elemIdx; i++){
+		idx = sexiTapeNext(tape, idx);
+	}
+
+	return idx;
+}
+
+size_t sexiTapeNext(SexiTape tape, size_t idx){
+	auto &entry = tape->entryData[idx];
+	return idx + (entry.type == SEXI_LIST || entry.type == SEXI_EMPTY ? entry.skip : 1);
+}
+
+SexiStr sexiTapeStr(SexiTape tape, size_t idx){
+	auto &entry = tape->entryData[idx];
+	switch(entry.type){
+		case SEXI_LIST: return { .len = 0, .ptr = nullptr };
+		case SEXI_EMPTY: return emptyListStr;
+		default: return { .len = entry.len, .ptr = tape->strBase + entry.off };
+	}
+}
+
+static SnapshotHeader snapshotHeader(SexiTape tape){
+	SnapshotHeader ret;
+	std::memcpy(ret.magic, snapshotMagic, sizeof(snapshotMagic));
+	ret.version = snapshotVersion;
+	ret.byteOrder = snapshotByteOrder;
+	ret.numExprs = tape->numExprs;
+	ret.numEntries = tape->numEntries;
+	ret.entriesOff = sizeof(SnapshotHeader);
+	ret.strsOff = ret.entriesOff + tape->numEntries * sizeof(SexiTapeEntry);
+	ret.strsSize = tape->strSize;
+	ret.reserved = 0;
+	return ret;
+}
+
+size_t sexiTapeSnapshot(SexiTape tape, void *buf, size_t cap){
+	const auto header = snapshotHeader(tape);
+	const auto size = std::size_t(header.strsOff + header.strsSize);
+
+	if(cap < size) return size;
+
+	auto out = static_cast<char*>(buf);
+	std::memcpy(out, &header, sizeof(header));
+	if(tape->numEntries) std::memcpy(out + header.entriesOff, tape->entryData, tape->numEntries * sizeof(SexiTapeEntry));
+	if(tape->strSize) std::memcpy(out + header.strsOff, tape->strBase, tape->strSize);
+
+	return size;
+}
+
+bool sexiTapeWriteSnapshot(SexiTape tape, const char *path){
+	auto file = std::fopen(path, "wb");
+	if(!file) return false;
+
+	const auto header = snapshotHeader(tape);
+
+	bool ok =
+		std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		std::fwrite(tape->entryData, sizeof(SexiTapeEntry), tape->numEntries, file) == tape->numEntries &&
+		std::fwrite(tape->strBase, 1, tape->strSize, file) == tape->strSize;
+
+	return std::fclose(file) == 0 && ok;
+}
+
+// check that every entry stays within the snapshot and the lists nest exactly as their counts say
+static std::string_view validateEntries(const SexiTapeEntry *entries, std::size_t numEntries, std::size_t numExprs, std::size_t strSize){
+	struct OpenList{
+		std::size_t end;
+		std::uint64_t remaining;
+	};
+
+	std::vector<OpenList> lists;
+	std::size_t numTop = 0;
+
+	for(std::size_t idx = 0; idx <= numEntries; idx++){
+		while(!lists.empty() && lists.back().end == idx){
+			if(lists.back().remaining) return "list length mismatch in snapshot";
+			lists.pop_back();
+		}
+
+		if(idx == numEntries) break;
+
+		if(lists.empty()){
+			++numTop;
+		}
+		else if(lists.back().remaining-- == 0){
+			return "list length mismatch in snapshot";
+		}
+
+		auto &entry = entries[idx];
+		switch(entry.type){
+			case SEXI_EMPTY:
+				if(entry.len != 0 || entry.skip != 1) return "invalid empty list in snapshot";
+				break;
+
+			case SEXI_LIST:
+				if(entry.len == 0 || entry.skip < 2 || entry.skip > numEntries - idx) return "invalid list in snapshot";
+				if(!lists.empty() && idx + entry.skip > lists.back().end) return "invalid list in snapshot";
+
+				lists.push_back({ idx + std::size_t(entry.skip), entry.len });
+				break;
+
+			case SEXI_ID:
+			case SEXI_STR:
+			case SEXI_NUM:
+				if(entry.off > strSize || entry.len > strSize - entry.off) return "string out of bounds in snapshot";
+				break;
+
+			default: return "invalid entry type in snapshot";
+		}
+	}
+
+	if(numTop != numExprs) return "expression count mismatch in snapshot";
+
+	return {};
+}
+
+// point the tape at a snapshot in memory, checking everything the accessors rely on
+static SexiTape sexiTapeAdopt(SexiTape tape, std::size_t len, const char *ptr){
+	SnapshotHeader header;
+
+	if(len < sizeof(header)) return sexiTapeFail(tape, "snapshot too small");
+
+	std::memcpy(&header, ptr, sizeof(header));
+
+	if(std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0) return sexiTapeFail(tape, "invalid snapshot header");
+	if(header.byteOrder != snapshotByteOrder) return sexiTapeFail(tape, "snapshot written with a different byte order");
+	if(header.version != snapshotVersion) return sexiTapeFail(tape, "unsupported snapshot version");
+
+	if(
+		header.entriesOff % alignof(SexiTapeEntry) != 0 ||
+		header.entriesOff > len ||
+		header.numEntries > (len - header.entriesOff) / sizeof(SexiTapeEntry) ||
+		header.strsOff > len ||
+		header.strsSize > len - header.strsOff
+	){
+		return sexiTapeFail(tape, "snapshot sections out of bounds");
+	}
+
+	if(reinterpret_cast<std::uintptr_t>(ptr) % alignof(SexiTapeEntry) != 0) return sexiTapeFail(tape, "misaligned snapshot");
+
+	auto entries = reinterpret_cast<const SexiTapeEntry*>(ptr + header.entriesOff);
+
+	std::string_view err;
+	try{
+		err = validateEntries(entries, header.numEntries, header.numExprs, header.strsSize);
+	}
+	catch(const std::bad_alloc&){
+		err = "failed to allocate memory";
+	}
+
+	if(!err.empty()) return sexiTapeFail(tape, err);
+
+	tape->numExprs = header.numExprs;
+	tape->entryData = entries;
+	tape->numEntries = header.numEntries;
+	tape->strBase = ptr + header.strsOff;
+	tape->strSize = header.strsSize;
+	return tape;
+}
+
+SexiTape sexiTapeFromSnapshot(size_t len, const void *ptr){
+	auto ret = sexiCreateTape(nullptr);
+	if(!ret) return nullptr;
+
+	return sexiTapeAdopt(ret, len, static_cast<const char*>(ptr));
+}
+
+SexiTape sexiTapeLoadSnapshot(const char *path){
+	auto ret = sexiCreateTape(nullptr);
+	if(!ret) return nullptr;
+
+	auto err = ret->file.open(path);
+	if(!err.empty()) return sexiTapeFail(ret, err);
+
+	return sexiTapeAdopt(ret, ret->file.size(), ret->file.data());
+}
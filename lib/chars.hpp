@@ -0,0 +1,67 @@
+#ifndef SEXI_CHARS_HPP
+#define SEXI_CHARS_HPP 1
+
+#include <array>
+#include <cstdint>
+
+namespace sexi::detail{
+	/**
+	 * @brief Character class bits, independent of the C locale.
+	 * Control characters other than whitespace and bytes above 0x7e have no class.
+	 */
+	enum CharClass: std::uint8_t{
+		CHAR_SPACE = 1 << 0, // ' ' and '\t' through '\r'
+		CHAR_DIGIT = 1 << 1, // '0' through '9'
+		CHAR_ALPHA = 1 << 2, // ASCII letters
+		CHAR_PUNCT = 1 << 3, // ASCII punctuation, as `std::ispunct` in the "C" locale
+		CHAR_PAREN = 1 << 4, // '(' and ')'
+		CHAR_ID = 1 << 5, // may appear inside an id
+
+		CHAR_ALNUM = CHAR_DIGIT | CHAR_ALPHA,
+		CHAR_ID_START = CHAR_ALPHA | CHAR_PUNCT,
+		CHAR_TOKEN_END = CHAR_SPACE | CHAR_PAREN,
+	};
+
+	constexpr std::array<std::uint8_t, 256> makeCharClasses() noexcept{
+		std::array<std::uint8_t, 256> ret = {};
+
+		for(unsigned c = 0; c < 256; c++){
+			std::uint8_t cls = 0;
+
+			if(c == ' ' || (c >= '\t' && c <= '\r')) cls |= CHAR_SPACE;
+			else if(c >= '0' && c <= '9') cls |= CHAR_DIGIT | CHAR_ID;
+			else if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) cls |= CHAR_ALPHA | CHAR_ID;
+			else if(c > ' ' && c < 127){
+				cls |= CHAR_PUNCT;
+
+				if(c == '(' || c == ')') cls |= CHAR_PAREN;
+				else if(c != '"') cls |= CHAR_ID;
+			}
+
+			ret[c] = cls;
+		}
+
+		return ret;
+	}
+
+	inline constexpr std::array<std::uint8_t, 256> charClasses = makeCharClasses();
+
+	constexpr std::uint8_t charClass(char c) noexcept{
+		return charClasses[static_cast<unsigned char>(c)];
+	}
+
+	constexpr bool charIs(char c, std::uint8_t cls) noexcept{
+		return (charClass(c) & cls) != 0;
+	}
+
+	/**
+	 * @brief Skip characters in any of the classes \p cls .
+	 * @returns pointer to the first character not in \p cls or \p end
+	 */
+	inline const char *skipChars(const char *it, const char *end, std::uint8_t cls) noexcept{
+		while(it != end && charIs(*it, cls)) ++it;
+		return it;
+	}
+}
+
+#endif // !SEXI_CHARS_HPP
@@ -0,0 +1,208 @@
+#include <cstring>
+
+#include <vector>
+
+#include "Expr.hpp"
+
+namespace {
+	// lists nested deeper than this spill their frames onto the heap
+	constexpr std::size_t inlineFrames = 64;
+
+	template<typename Frame>
+	class FrameStack{
+		public:
+			bool empty() const noexcept{ return m_depth == 0; }
+
+			Frame &top() noexcept{ return m_depth <= inlineFrames ? m_inline[m_depth - 1] : m_heap.back(); }
+
+			void push(const Frame &frame){
+				if(m_depth < inlineFrames){
+					m_inline[m_depth] = frame;
+				}
+				else{
+					m_heap.push_back(frame);
+				}
+
+				++m_depth;
+			}
+
+			void pop() noexcept{
+				if(m_depth > inlineFrames) m_heap.pop_back();
+				--m_depth;
+			}
+
+		private:
+			Frame m_inline[inlineFrames];
+			std::vector<Frame> m_heap;
+			std::size_t m_depth = 0;
+	};
+
+	constexpr std::uint64_t hashMul0 = 0x9e3779b97f4a7c15, hashMul1 = 0xbf58476d1ce4e5b9;
+
+	inline std::uint64_t mixHash(std::uint64_t h) noexcept{
+		h ^= h >> 31;
+		h *= hashMul1;
+		h ^= h >> 29;
+		return h;
+	}
+
+	inline std::uint64_t combineHash(std::uint64_t h, std::uint64_t elem) noexcept{
+		return ((h << 5 | h >> 59) ^ elem) * hashMul0;
+	}
+
+	// strings are consumed a word at a time, the tail padded with zeros
+	std::uint64_t hashLeaf(SexiExprConst expr) noexcept{
+		auto str = expr->type == SEXI_EMPTY ? SexiStr{ .len = 2, .ptr = "()" } : expr->str;
+		auto it = str.ptr;
+		auto n = str.len;
+
+		std::uint64_t h = (std::uint64_t(expr->type) + 1) * hashMul0 ^ n;
+
+		for(; n >= 8; it += 8, n -= 8){
+			std::uint64_t word;
+			std::memcpy(&word, it, 8);
+			h = (h ^ word) * hashMul1;
+			h ^= h >> 29;
+		}
+
+		std::uint64_t tail = 0;
+		std::memcpy(&tail, it, n);
+
+		return mixHash(h ^ tail);
+	}
+
+	// lists cache their hash, which may be computed by several threads at once
+	inline std::uint64_t loadListHash(SexiExprConst list) noexcept{
+#ifdef _MSC_VER
+		return std::uint64_t(__iso_volatile_load64(reinterpret_cast<const volatile __int64*>(&list->hash)));
+#else
+		return __atomic_load_n(&list->hash, __ATOMIC_RELAXED);
+#endif
+	}
+
+	inline void storeListHash(SexiExprConst list, std::uint64_t hash) noexcept{
+		// lists created by hand can still grow, anywhere inside them, so only those of a result or pool keep a hash
+		if(list->onHeap) return;
+
+		// the cache isn't part of the value, so it's written through const expressions too
+		auto dest = &const_cast<SexiExpr>(list)->hash;
+#ifdef _MSC_VER
+		__iso_volatile_store64(reinterpret_cast<volatile __int64*>(dest), __int64(hash));
+#else
+		__atomic_store_n(dest, hash, __ATOMIC_RELAXED);
+#endif
+	}
+
+	inline bool leafEqual(SexiExprConst lhs, SexiExprConst rhs) noexcept{
+		if(lhs->type == SEXI_EMPTY) return true;
+		return lhs->str.len == rhs->str.len && std::memcmp(lhs->str.ptr, rhs->str.ptr, lhs->str.len) == 0;
+	}
+
+	// lists that have both cached a hash can be told apart without looking inside
+	inline bool listsMayBeEqual(SexiExprConst lhs, SexiExprConst rhs) noexcept{
+		// a list that can't be built isn't known to be equal to anything
+		if(!sexi::detail::forceList(lhs) || !sexi::detail::forceList(rhs)) return false;
+
+		if(lhs->list.n != rhs->list.n) return false;
+
+		auto lhsHash = loadListHash(lhs), rhsHash = loadListHash(rhs);
+		return !lhsHash || !rhsHash || lhsHash == rhsHash;
+	}
+
+	struct EqualFrame{
+		SexiExprConst lhs, rhs;
+		std::size_t idx;
+	};
+
+	struct HashFrame{
+		SexiExprConst list;
+		std::size_t idx;
+		std::uint64_t hash;
+	};
+}
+
+bool sexiExprEqual(SexiExprConst lhs, SexiExprConst rhs){
+	if(lhs == rhs) return true;
+	if(lhs->type != rhs->type) return false;
+	if(lhs->type != SEXI_LIST) return leafEqual(lhs, rhs);
+	if(!listsMayBeEqual(lhs, rhs)) return false;
+
+	FrameStack<EqualFrame> stack;
+	stack.push({ lhs, rhs, 0 });
+
+	while(!stack.empty()){
+		auto &frame = stack.top();
+
+		if(frame.idx == frame.lhs->list.n){
+			stack.pop();
+			continue;
+		}
+
+		auto lhsElem = frame.lhs->list.exprs[frame.idx];
+		auto rhsElem = frame.rhs->list.exprs[frame.idx];
+		++frame.idx;
+
+		// shared subtrees, like those of a pool, are equal without a look inside
+		if(lhsElem == rhsElem) continue;
+		if(lhsElem->type != rhsElem->type) return false;
+
+		if(lhsElem->type != SEXI_LIST){
+			if(!leafEqual(lhsElem, rhsElem)) return false;
+		}
+		else if(!listsMayBeEqual(lhsElem, rhsElem)){
+			return false;
+		}
+		else{
+			stack.push({ lhsElem, rhsElem, 0 });
+		}
+	}
+
+	return true;
+}
+
+uint64_t sexiExprHash(SexiExprConst expr){
+	if(expr->type != SEXI_LIST) return hashLeaf(expr);
+
+	// a lazy list keeps its context where the hash goes until it's built
+	if(!sexi::detail::forceList(expr)) return 0;
+
+	if(auto cached = loadListHash(expr)) return cached;
+
+	FrameStack<HashFrame> stack;
+	stack.push({ expr, 0, mixHash(expr->list.n ^ hashMul1) });
+
+	while(true){
+		auto &frame = stack.top();
+
+		if(frame.idx == frame.list->list.n){
+			// 0 marks a list without a cached hash
+			auto hash = mixHash(frame.hash);
+			if(!hash) hash = 1;
+
+			storeListHash(frame.list, hash);
+			stack.pop();
+
+			if(stack.empty()) return hash;
+
+			auto &parent = stack.top();
+			parent.hash = combineHash(parent.hash, hash);
+			continue;
+		}
+
+		auto elem = frame.list->list.exprs[frame.idx++];
+
+		if(elem->type != SEXI_LIST){
+			frame.hash = combineHash(frame.hash, hashLeaf(elem));
+		}
+		else if(!sexi::detail::forceList(elem)){
+			// lists on the stack are left without a hash, so hashing again retries
+			return 0;
+		}
+		else if(auto cached = loadListHash(elem)){
+			frame.hash = combineHash(frame.hash, cached);
+		}
+		else{
+			stack.push({ elem, 0, mixHash(elem->list.n ^ hashMul1) });
+		}
+	}
+}
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "parse.hpp"
+#include "scan.hpp"
+
+using namespace sexi::detail;
+
+// sources are only split into chunks at least this big, smaller ones aren't worth a thread
+static constexpr std::size_t minChunkSize = 256 * 1024;
+
+// hand out a few chunks per thread so threads that finish early can pick up the slack
+static constexpr std::size_t chunksPerThread = 4;
+
+namespace {
+	/**
+	 * @brief Threads started by the first parallel parse and kept for the next ones.
+	 *
+	 * The pool grows to the most threads any parse asked for. Parses on several
+	 * threads share it, and none of them waits for work that isn't its own.
+	 */
+	class WorkerPool{
+		public:
+			using WorkFn = void(*)(void *user) noexcept;
+
+			WorkerPool() = default;
+			WorkerPool(const WorkerPool&) = delete;
+
+			~WorkerPool(){
+				{
+					std::lock_guard lock(m_mutex);
+					m_stop = true;
+				}
+
+				m_wake.notify_all();
+
+				for(auto &&thread : m_threads){
+					thread.join();
+				}
+			}
+
+			WorkerPool &operator=(const WorkerPool&) = delete;
+
+			/**
+			 * @brief Call \p fn on up to \p n pool threads and on the calling thread, returning once every call is over.
+			 * Calls no pool thread got to by the time the caller's returns are dropped,
+			 * so \p fn must hand out the work itself and return once there's none left.
+			 */
+			void run(std::size_t n, WorkFn fn, void *user) noexcept{
+				Job job{ fn, user, 0, 0 };
+				bool queued = false;
+
+				{
+					std::lock_guard lock(m_mutex);
+					grow(n);
+
+					try{
+						if(n && !m_threads.empty()){
+							m_queue.push_back(&job);
+							job.slots = std::min(n, m_threads.size());
+							queued = true;
+						}
+					}
+					catch(const std::bad_alloc&){
+						// the calling thread does it all
+					}
+				}
+
+				if(queued) m_wake.notify_all();
+
+				fn(user);
+
+				std::unique_lock lock(m_mutex);
+
+				if(job.slots){
+					m_queue.erase(std::find(m_queue.begin(), m_queue.end(), &job));
+				}
+
+				m_done.wait(lock, [&]{ return job.running == 0; });
+			}
+
+		private:
+			struct Job{
+				WorkFn fn;
+				void *user;
+				std::size_t slots; // calls still queued
+				std::size_t running; // calls started and not finished yet
+			};
+
+			// with the lock held
+			void grow(std::size_t n) noexcept{
+				try{
+					while(m_threads.size() < n){
+						m_threads.emplace_back([this]{ work(); });
+					}
+				}
+				catch(const std::system_error&){
+					// make do with the threads there are
+				}
+				catch(const std::bad_alloc&){}
+			}
+
+			void work() noexcept{
+				std::unique_lock lock(m_mutex);
+
+				while(true){
+					m_wake.wait(lock, [&]{ return m_stop || !m_queue.empty(); });
+					if(m_stop) return;
+
+					auto job = m_queue.front();
+					if(--job->slots == 0) m_queue.erase(m_queue.begin());
+					++job->running;
+
+					lock.unlock();
+					job->fn(job->user);
+					lock.lock();
+
+					if(--job->running == 0) m_done.notify_all();
+				}
+			}
+
+			std::mutex m_mutex; // guards everything below
+			std::condition_variable m_wake, m_done;
+			std::vector<Job*> m_queue; // jobs with calls left to hand out, oldest first
+			std::vector<std::thread> m_threads;
+			bool m_stop = false;
+	};
+
+	WorkerPool &workerPool() noexcept{
+		static WorkerPool ret;
+		return ret;
+	}
+}
+
+// split after the first top-level closing paren at or past every multiple of the ideal chunk size
+static std::vector<const char*> findChunkEnds(const char *beg, const char *end, std::size_t numChunks){
+	constexpr auto blockSize = StructuralScanner::blockSize;
+
+	const auto len = std::size_t(end - beg);
+	const auto chunkSize = len / numChunks;
+
+	std::vector<const char*> ret;
+	ret.reserve(numChunks);
+
+	// parens inside strings don't count, so this is the depth a serial parse would see
+	ScanState state;
+	std::ptrdiff_t depth = 0;
+	std::size_t target = chunkSize;
+
+	for(std::size_t off = 0; off < len && ret.size() + 1 < numChunks; off += blockSize){
+		ParenMasks parens;
+
+		if(len - off >= blockSize){
+			parens = scanParens(beg + off, state);
+		}
+		else{
+			char tail[blockSize];
+			std::memset(tail, ' ', blockSize);
+			std::memcpy(tail, beg + off, len - off);
+			parens = scanParens(tail, state);
+		}
+
+		// only blocks that may hold a split point need their parens visited in order
+		if(off + blockSize <= target){
+			depth += std::ptrdiff_t(countOnes(parens.open)) - std::ptrdiff_t(countOnes(parens.close));
+			continue;
+		}
+
+		auto bits = parens.open | parens.close;
+		while(bits){
+			auto idx = countTrailingZeros(bits);
+			bits &= bits - 1;
+
+			if(parens.open & (std::uint64_t(1) << idx)){
+				++depth;
+			}
+			else if(--depth == 0 && off + idx >= target){
+				auto splitOff = off + idx + 1;
+				ret.emplace_back(beg + splitOff);
+				target = splitOff + chunkSize;
+			}
+		}
+	}
+
+	ret.emplace_back(end);
+	return ret;
+}
+
+static bool parseChunks(SexiParseResult res, const char *beg, const char *end, const SexiParseOptions &opts){
+	const auto maxChunks = std::size_t(end - beg) / minChunkSize;
+	const auto numThreads = std::min(opts.numThreads, maxChunks);
+
+	// pools are locked by each parse, so their chunks couldn't run concurrently anyway
+	if(numThreads < 2 || opts.pool){
+		return parseExprs(res, beg, end, opts);
+	}
+
+	auto chunkEnds = findChunkEnds(beg, end, std::min(numThreads * chunksPerThread, maxChunks));
+	const auto numChunks = chunkEnds.size();
+
+	if(numChunks < 2){
+		return parseExprs(res, beg, end, opts);
+	}
+
+	// the first chunk goes straight into the result, the rest get merged after it
+	std::unique_ptr<SexiParseResultT[]> chunkResults(new SexiParseResultT[numChunks - 1]());
+
+	// chunk arenas end up owned by the result, so they allocate like it does
+	for(std::size_t i = 0; i < numChunks - 1; i++){
+		chunkResults[i].arena.setAllocator(res->alloc);
+		chunkResults[i].src = beg;
+		chunkResults[i].lazy = res->lazy;
+	}
+
+	std::atomic<std::size_t> nextChunk(0);
+
+	auto work = [&]() noexcept{
+		ParseStacks stacks;
+
+		for(auto idx = nextChunk.fetch_add(1, std::memory_order_relaxed); idx < numChunks; idx = nextChunk.fetch_add(1, std::memory_order_relaxed)){
+			auto chunkRes = idx == 0 ? res : &chunkResults[idx - 1];
+			auto chunkBeg = idx == 0 ? beg : chunkEnds[idx - 1];
+
+			// running out of memory becomes the error of the chunk, nothing may escape the thread
+			parseExprs(chunkRes, chunkBeg, chunkEnds[idx], opts, stacks);
+		}
+	};
+
+	// the calling thread works too
+	workerPool().run(numThreads - 1, [](void *user) noexcept{ (*static_cast<decltype(work)*>(user))(); }, &work);
+
+	// recovered errors don't stop a parse, anything else does
+	auto stopsParse = [&](SexiParseResult chunk){ return chunk->hasError && (!opts.recover || !chunk->hasErrorPos); };
+
+	if(stopsParse(res)) return false;
+
+	std::size_t numExprs = res->exprs.size();
+	for(std::size_t i = 0; i < numChunks - 1; i++){
+		numExprs += chunkResults[i].exprs.size();
+	}
+
+	res->exprs.reserve(numExprs);
+	res->chunkArenas.reserve(numChunks - 1);
+
+	// keep expressions up to the first error, like a serial parse would
+	for(std::size_t i = 0; i < numChunks - 1; i++){
+		auto &chunk = chunkResults[i];
+
+		res->exprs.insert(res->exprs.end(), chunk.exprs.begin(), chunk.exprs.end());
+		res->chunkArenas.emplace_back(std::move(chunk.arena));
+		res->errors.insert(res->errors.end(), chunk.errors.begin(), chunk.errors.end());
+
+		if(!res->locations.append(chunk.locations)){
+			res->hasError = true;
+			res->err = "failed to allocate location";
+			res->hasErrorPos = false;
+			return false;
+		}
+
+		if(chunk.hasError && (!res->hasError || !chunk.hasErrorPos)){
+			res->hasError = true;
+			res->err = chunk.err;
+			res->hasErrorPos = chunk.hasErrorPos;
+		}
+
+		if(stopsParse(&chunk)) return false;
+	}
+
+	return !res->hasError;
+}
+
+bool sexi::detail::parseExprsParallel(SexiParseResult res, const char *beg, const char *end, const SexiParseOptions &opts){
+	res->src = beg;
+
+	if(!initLazy(res, opts)) return false;
+
+	try{
+		if(parseChunks(res, beg, end, opts)) return true;
+	}
+	catch(const std::bad_alloc&){
+		// splitting and merging chunks allocates too, the chunks themselves catch their own failures
+		res->hasError = true;
+		res->err = "failed to allocate memory";
+		res->hasErrorPos = false;
+		return false;
+	}
+
+	// errors are in source order, so each only counts the lines since the one before
+	auto lineBeg = beg;
+	std::size_t line = 1;
+
+	for(auto &err : res->errors){
+		auto errIt = beg + err.pos.offset;
+
+		auto errLineBeg = errIt;
+		while(errLineBeg != lineBeg && errLineBeg[-1] != '\n') --errLineBeg;
+
+		line += countNewlines(lineBeg, errLineBeg);
+		lineBeg = errLineBeg;
+
+		err.pos.line = line;
+		err.pos.column = std::size_t(errIt - lineBeg) + 1;
+	}
+
+	return false;
+}
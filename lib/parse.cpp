@@ -1,261 +1,492 @@
+#include <cstdint>
 #include <cstdlib>
-#include <cctype>
+#include <cstring>
 
 #include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
 #include <vector>
 
-#include "sexi.h"
+#include "parse.hpp"
+#include "Pool.hpp"
+#include "scan.hpp"
+#include "walk.hpp"
 
-struct SexiParseResultT{
-	bool hasError;
-	std::string_view err;
-	std::vector<SexiExpr> exprs;
-	std::vector<std::vector<SexiExpr>> storage;
-};
+using namespace sexi::detail;
 
 void sexiDestroyParseResult(SexiParseResult res){
-	for(auto expr : res->exprs){
-		sexiDestroyExpr(expr);
-	}
+	auto alloc = res->alloc;
+	std::destroy_at(res);
+	deallocate(alloc, res);
+}
 
-	for(auto &&exprs : res->storage){
-		for(auto expr : exprs){
-			sexiDestroyExpr(expr);
-		}
+// failing to build a lazy list is an error of the result too, found after the parse
+static bool lazyFailed(SexiParseResult res) noexcept{
+	return res->lazy && res->lazy->failed.load(std::memory_order_acquire);
+}
+
+bool sexiParseResultHasError(SexiParseResult res){ return res->hasError || lazyFailed(res); }
+
+SexiStr sexiParseResultError(SexiParseResult res){
+	if(!res->hasError && lazyFailed(res)){
+		constexpr std::string_view msg = "failed to allocate lazy list";
+		return { .len = msg.size(), .ptr = msg.data() };
 	}
+	return { .len = res->err.size(), .ptr = res->err.data() };
+}
 
-	std::destroy_at(res);
-	std::free(res);
+bool sexiParseResultErrorPos(SexiParseResult res, SexiSourcePos *pos){
+	if(!res->hasError || !res->hasErrorPos) return false;
+
+	*pos = res->errors.front().pos;
+	return true;
 }
 
-bool sexiParseResultHasError(SexiParseResult res){ return res->hasError; }
-SexiStr sexiParseResultError(SexiParseResult res){ return { .len = res->err.size(), .ptr = res->err.data() }; }
+size_t sexiParseResultNumErrors(SexiParseResult res){ return res->errors.size(); }
+const SexiParseErrorInfo *sexiParseResultErrors(SexiParseResult res){ return res->errors.empty() ? nullptr : res->errors.data(); }
+
+bool sexiParseResultSpan(SexiParseResult res, SexiExprConst expr, SexiSourceSpan *span){
+	return res->locations.find(res->exprs.size(), res->exprs.data(), expr, *span);
+}
 
 size_t sexiParseResultNumExprs(SexiParseResult res){ return res->exprs.size(); }
 const SexiExprConst *sexiParseResultExprs(SexiParseResult res){ return res->exprs.data(); }
 
-using ParseInnerResult = std::tuple<const char*, SexiExpr>;
-
-inline ParseInnerResult sexiParseError(SexiParseResult res, std::string_view msg){
+inline SexiExpr sexiParseError(SexiParseResult res, std::string_view msg){
 	res->hasError = true;
 	res->err = msg;
-	return std::make_tuple(nullptr, nullptr);
+	res->hasErrorPos = false;
+	return nullptr;
 }
 
-inline ParseInnerResult sexiParseId(SexiParseResult res, const char *beg, const char *end, bool copyStrs){
-	auto it = beg + 1;
-	auto delimIt = end;
-
-	while(it != end){
-		if(std::isspace(*it)){
-			delimIt = it;
-			++it;
-			break;
-		}
-		else if(*it == ')'){
-			delimIt = it;
-			break;
-		}
-		else if(!std::ispunct(*it) && !std::isalnum(*it)){
-			return sexiParseError(res, "unexpected character in identifier");
-		}
-
-		++it;
+// every error in the source is kept and the first becomes the error of the result,
+// line and column are left for the end of the parse, when the whole source is at hand
+inline SexiExpr sexiParseError(SexiParseResult res, std::string_view msg, const char *at){
+	try{
+		res->errors.push_back({
+			.msg = { .len = msg.size(), .ptr = msg.data() },
+			.pos = { .offset = std::size_t(at - res->src), .line = 0, .column = 0 },
+		});
+	}
+	catch(const std::bad_alloc&){
+		return sexiParseError(res, "failed to allocate error");
 	}
 
-	if(delimIt == end){
-		return sexiParseError(res, "unexpected end of source in id");
+	if(!res->hasError){
+		res->hasError = true;
+		res->err = msg;
+		res->hasErrorPos = true;
 	}
 
-	SexiStr str = {
-		.len = uintptr_t(delimIt) - uintptr_t(beg),
-		.ptr = beg
-	};
+	return nullptr;
+}
 
-	auto idExpr = sexiCreateId(str);
-	if(copyStrs) sexiExprOwnString(idExpr);
+namespace {
+	// builds the expression tree from the events of walkExprs
+	class TreeBuilder{
+		public:
+			TreeBuilder(SexiParseResult res, ParseStacks &stacks, const SexiParseOptions &opts) noexcept
+				: m_res(res), m_elems(stacks.elems), m_frames(stacks.frames), m_listBegins(stacks.listBegins), m_symbolCache(stacks.symbols)
+				, m_copyStrs(opts.copyStrs), m_symbols(opts.symbols), m_pool(opts.pool)
+				, m_locations(opts.locations && !opts.pool ? &res->locations : nullptr)
+				, m_formBeg(nullptr), m_complete(res->locations.mark())
+				, m_lazy(opts.lazyDepth && !opts.pool ? res->lazy : nullptr), m_lazyDepth(opts.lazyDepth)
+				, m_skipDepth(0), m_skipBeg(nullptr), m_skipHasElems(false)
+			{
+				if(m_pool) m_poolLock = std::unique_lock(m_pool->mutex);
+
+				m_elems.clear();
+				m_frames.clear();
+				m_listBegins.clear();
+			}
 
-	return std::make_tuple(it, idExpr);
-}
+			bool listBegin(const char *it){
+				if(m_skipDepth){
+					++m_skipDepth;
+					m_skipHasElems = true;
+					return true;
+				}
+
+				if(m_frames.empty()) m_formBeg = it;
+
+				// everything up to the matching paren is only checked, see lazyList
+				if(m_lazy && m_frames.size() + 1 >= m_lazyDepth){
+					m_skipDepth = 1;
+					m_skipBeg = it;
+					m_skipHasElems = false;
+					return true;
+				}
+
+				m_frames.emplace_back(m_elems.size());
+				if(m_locations) m_listBegins.emplace_back(it);
+				return true;
+			}
 
-inline ParseInnerResult sexiParseStr(SexiParseResult res, const char *beg, const char *end, bool copyStrs){
-	auto it = beg + 1;
-	auto delimIt = end;
+			bool listEnd(const char *it){
+				if(m_skipDepth){
+					if(--m_skipDepth) return true;
+					return lazyList(it);
+				}
 
-	while(it != end){
-		if(*it == '"'){
-			delimIt = it;
-			++it;
-			break;
-		}
-		else if(*it == '\\'){
-			++it;
-		}
+				auto elemsBase = m_frames.back();
+				m_frames.pop_back();
 
-		++it;
-	}
+				auto n = m_elems.size() - elemsBase;
+				auto expr = m_pool ? m_pool->list(n, m_elems.data() + elemsBase) : adoptList(m_res->arena, n, m_elems.data() + elemsBase);
+				m_elems.resize(elemsBase);
 
-	if(delimIt == end){
-		return sexiParseError(res, "unexpected end of source in string");
-	}
+				SexiStr src = { .len = 0, .ptr = nullptr };
+				if(m_locations){
+					auto beg = m_listBegins.back();
+					m_listBegins.pop_back();
+					src = { .len = std::size_t(it + 1 - beg), .ptr = beg };
+				}
+
+				return push(expr, src);
+			}
 
-	auto str = SexiStr{
-		.len = uintptr_t(it) - uintptr_t(beg),
-		.ptr = beg
+			bool id(SexiStr str){
+				if(m_skipDepth) return skipToken();
+
+				if(m_pool){
+					auto interned = str;
+					auto sym = m_symbols ? m_symbolCache.intern(m_symbols, str, interned) : SEXI_NO_SYMBOL;
+
+					return push(m_pool->leaf(SEXI_ID, interned, sym), str);
+				}
+
+				if(m_symbols) return push(createSymbol(m_res->arena, str, m_symbols, m_symbolCache), str);
+				return push(createId(m_res->arena, str, m_copyStrs), str);
+			}
+
+			bool str(SexiStr str){
+				if(m_skipDepth) return skipToken();
+
+				if(m_pool) return push(m_pool->leaf(SEXI_STR, str, SEXI_NO_SYMBOL), str);
+				return push(createStr(m_res->arena, str, m_copyStrs), str);
+			}
+
+			bool num(SexiStr str){
+				if(m_skipDepth) return skipToken();
+
+				if(m_pool) return push(m_pool->leaf(SEXI_NUM, str, SEXI_NO_SYMBOL), str);
+				return push(createNum(m_res->arena, str, m_copyStrs), str);
+			}
+
+			void error(std::string_view msg, const char *at){ sexiParseError(m_res, msg, at); }
+
+			/**
+			 * @brief Open paren of the unfinished top-level expression, `nullptr` between expressions.
+			 */
+			const char *openForm() const noexcept{ return m_frames.empty() && !m_skipDepth ? nullptr : m_formBeg; }
+
+			/**
+			 * @brief Forget the spans of the unfinished top-level expression after an error.
+			 * Its expressions stay in the arena until the result is destroyed.
+			 */
+			void dropUnfinished() noexcept{
+				if(m_locations) m_locations->truncate(m_complete);
+			}
+
+		private:
+			bool skipToken() noexcept{
+				m_skipHasElems = true;
+				return true;
+			}
+
+			// the list skipped since `m_skipBeg` keeps its text to be built from on first access
+			bool lazyList(const char *it){
+				SexiStr src = { .len = std::size_t(it + 1 - m_skipBeg), .ptr = m_skipBeg };
+
+				// an empty list is as cheap to build as to leave for later
+				if(!m_skipHasElems) return push(adoptList(m_res->arena, 0, nullptr), src);
+
+				auto text = src;
+				if(m_copyStrs) text.ptr = m_res->arena.copyStr(src.ptr, src.len);
+
+				return push(text.ptr ? createLazyList(m_res->arena, text, m_lazy) : nullptr, src);
+			}
+
+			// `src` is the source text of the expression, only used when recording locations
+			bool push(SexiExpr expr, SexiStr src){
+				if(!expr){
+					sexiParseError(m_res, "failed to allocate expression");
+					return false;
+				}
+
+				if(m_locations && !m_locations->push(std::size_t(src.ptr - m_res->src), src.len)){
+					sexiParseError(m_res, "failed to allocate location");
+					return false;
+				}
+
+				if(m_frames.empty()){
+					m_res->exprs.emplace_back(expr);
+					if(m_locations) m_complete = m_locations->mark();
+				}
+				else{
+					m_elems.emplace_back(expr);
+				}
+
+				return true;
+			}
+
+			SexiParseResult m_res;
+			std::vector<SexiExpr> &m_elems;
+			std::vector<std::size_t> &m_frames;
+			std::vector<const char*> &m_listBegins;
+			SymbolCache &m_symbolCache;
+			bool m_copyStrs;
+			SexiSymbolTable m_symbols;
+			SexiExprPoolT *m_pool;
+			LocationTable *m_locations; // `nullptr` unless recording locations
+			const char *m_formBeg; // open paren of the current top-level expression
+			LocationTable::Mark m_complete; // locations up to the last complete top-level expression
+			std::unique_lock<std::mutex> m_poolLock; // held until the parse is done
+			LazyContext *m_lazy; // `nullptr` unless leaving lists unbuilt
+			std::size_t m_lazyDepth;
+			std::size_t m_skipDepth; // depth inside the list being skipped, 0 when building
+			const char *m_skipBeg; // open paren of the list being skipped
+			bool m_skipHasElems;
 	};
 
-	// check delimiter
+	// forwards the events of walkExprs to the callbacks of sexiParseEvents
+	class EventForwarder{
+		public:
+			EventForwarder(const SexiParseEvents &events, void *user, const char *beg) noexcept
+				: m_events(events), m_user(user), m_beg(beg){}
 
-	if(*it == ')'){
-		delimIt = it;
-	}
-	else if(std::isspace(*it)){
-		delimIt = it;
-		++it;
-	}
-	else{
-		return sexiParseError(res, "unexpected character in string");
-	}
+			bool listBegin(const char *it){ return emit(m_events.listBegin, { .len = 1, .ptr = it }); }
+			bool listEnd(const char *it){ return emit(m_events.listEnd, { .len = 1, .ptr = it }); }
+
+			bool id(SexiStr str){ return emit(m_events.id, str); }
+			bool str(SexiStr str){ return emit(m_events.str, str); }
+			bool num(SexiStr str){ return emit(m_events.num, str); }
+
+			void error(std::string_view msg, const char*){ m_err = msg; }
 
-	auto strExpr = sexiCreateStr(str);
-	if(copyStrs) sexiExprOwnString(strExpr);
+			std::string_view err() const noexcept{ return m_err; }
 
-	return std::make_tuple(it, strExpr);
+		private:
+			bool emit(SexiParseEventFn fn, SexiStr str){
+				if(fn && !fn(m_user, str, std::size_t(str.ptr - m_beg))){
+					m_err = "parsing stopped by event handler";
+					return false;
+				}
+
+				return true;
+			}
+
+			const SexiParseEvents &m_events;
+			void *m_user;
+			const char *m_beg;
+			std::string_view m_err;
+	};
 }
 
-inline ParseInnerResult sexiParseNum(SexiParseResult res, const char *beg, const char *end, bool copyStrs){
-	auto it = beg + 1;
-	auto delimIt = end;
+// where to pick up after an error: past the end of the top-level expression opened at `from`,
+// or at the next opening paren when `from` is between expressions
+static const char *findResyncPoint(const char *from, const char *end, bool inExpr) noexcept{
+	constexpr auto blockSize = StructuralScanner::blockSize;
 
-	bool hasDecimal = false;
+	ScanState state;
+	std::size_t depth = 0;
 
-	while(it != end){
-		if(std::isspace(*it)){
-			delimIt = it;
-			++it;
-			break;
+	for(auto block = from; block < end; block += blockSize){
+		ParenMasks parens;
+
+		if(std::size_t(end - block) >= blockSize){
+			parens = scanParens(block, state);
 		}
-		else if(*it == ')'){
-			delimIt = it;
-			break;
+		else{
+			char tail[blockSize];
+			std::memset(tail, ' ', blockSize);
+			std::memcpy(tail, block, std::size_t(end - block));
+			parens = scanParens(tail, state);
 		}
-		else if(*it == '.'){
-			if(!hasDecimal){
-				hasDecimal = true;
+
+		auto bits = parens.open | parens.close;
+		while(bits){
+			auto idx = countTrailingZeros(bits);
+			bits &= bits - 1;
+
+			const bool isOpen = parens.open & (std::uint64_t(1) << idx);
+
+			if(!inExpr){
+				if(isOpen) return block + idx;
 			}
-			else{
-				return sexiParseError(res, "multiple decimal points in number");
+			else if(isOpen){
+				++depth;
+			}
+			else if(depth && --depth == 0){
+				return block + idx + 1;
 			}
 		}
-		else if(!std::isalnum(*it)){
-			return sexiParseError(res, "unexpected character in number");
-		}
+	}
 
-		++it;
+	return nullptr;
+}
+
+static bool buildExprs(SexiParseResult res, const char *beg, const char *end, const SexiParseOptions &opts, ParseStacks &stacks){
+	if(!opts.recover){
+		TreeBuilder builder(res, stacks, opts);
+		return walkExprs(beg, end, opts.maxDepth, builder);
 	}
 
-	if(delimIt == end){
-		return sexiParseError(res, "unexpected end of source in number");
+	for(auto it = beg; it;){
+		TreeBuilder builder(res, stacks, opts);
+		if(walkExprs(it, end, opts.maxDepth, builder)) break;
+
+		// running out of memory isn't something to skip over
+		if(!res->hasErrorPos) return false;
+
+		builder.dropUnfinished();
+
+		auto errIt = res->src + res->errors.back().pos.offset;
+		auto formBeg = builder.openForm();
+
+		// stray tokens are skipped from the one that failed, so a string there is skipped whole
+		it = formBeg ? findResyncPoint(formBeg, end, true) : findResyncPoint(errIt, end, false);
 	}
 
-	auto str = SexiStr{
-		.len = uintptr_t(delimIt) - uintptr_t(beg),
-		.ptr = beg
-	};
+	return !res->hasError;
+}
 
-	auto numExpr = sexiCreateNum(str);
-	if(copyStrs) sexiExprOwnString(numExpr);
+// containers of the result get their memory from `opts.allocator` , which may run out at any point
+bool sexi::detail::parseExprs(SexiParseResult res, const char *beg, const char *end, const SexiParseOptions &opts, ParseStacks &stacks){
+	try{
+		return buildExprs(res, beg, end, opts, stacks);
+	}
+	catch(const std::bad_alloc&){
+		sexiParseError(res, "failed to allocate memory");
+		return false;
+	}
+}
 
-	return std::make_tuple(it, numExpr);
+void LazyContextDeleter::operator()(LazyContext *ctx) const noexcept{
+	std::destroy_at(ctx);
+	deallocate(alloc, ctx);
 }
 
-inline ParseInnerResult sexiParseList(SexiParseResult res, const char *beg, const char *end, bool copyStrs){
-	auto it = beg + 1;
-	auto delimIt = end;
+// lists are built whole, a level at a time would walk the text of deep ones over and over
+LazyContext::LazyContext(const SexiAllocator *alloc, const SexiParseOptions &parseOpts) noexcept
+	: scratch(alloc), opts(parseOpts)
+{
+	opts.copyStrs = false; // the text is the source or a copy owned by the result
+	opts.maxDepth = 0;
+	opts.numThreads = 0;
+	opts.pool = nullptr;
+	opts.allocator = alloc;
+	opts.locations = false;
+	opts.recover = false;
+	opts.lazyDepth = 0;
+}
 
-	std::vector<SexiExpr> elems;
+bool sexi::detail::initLazy(SexiParseResult res, const SexiParseOptions &opts) noexcept{
+	if(!opts.lazyDepth || opts.pool) return true;
 
-	// most possible elements is single-character expressions separated by spaces till end of source
-	elems.reserve((std::uintptr_t(end) - std::uintptr_t(beg)) / 2);
+	auto mem = allocate(res->alloc, sizeof(LazyContext));
+	if(!mem){
+		sexiParseError(res, "failed to allocate lazy context");
+		return false;
+	}
 
-	SexiExpr expr = nullptr;
+	res->lazyOwner.reset(new(mem) LazyContext(res->alloc, opts));
+	res->lazy = res->lazyOwner.get();
+	return true;
+}
 
-	while(it != end){
-		if(std::isspace(*it)){
-			++it;
-			continue;
-		}
-		else if(std::isdigit(*it)){
-			std::tie(it, expr) = sexiParseNum(res, it, end, copyStrs);
-			if(!it) return std::make_tuple(it, expr);
-		}
-		else if(*it == '"'){
-			std::tie(it, expr) = sexiParseStr(res, it, end, copyStrs);
-			if(!it) return std::make_tuple(it, expr);
-		}
-		else if(*it == '('){
-			std::tie(it, expr) = sexiParseList(res, it, end, copyStrs);
-			if(!it) return std::make_tuple(it, expr);
-		}
-		else if(*it == ')'){
-			delimIt = it;
-			++it;
-			break;
+bool sexi::detail::expandList(SexiExprConst list) noexcept{
+	// `lazyCtx` is only read by the thread that claimed the list, anyone else waits until it's done
+	while(!claimLazyList(list)){
+		switch(loadLazyState(list)){
+			case lazyBuilding: std::this_thread::yield(); break;
+			case lazyPending: break;
+			default: return true;
 		}
-		else if(std::ispunct(*it) || std::isalpha(*it)){
-			std::tie(it, expr) = sexiParseId(res, it, end, copyStrs);
-			if(!it) return std::make_tuple(it, expr);
-		}
-		else{
-			for(auto elem : elems){ sexiDestroyExpr(elem); }
-			return sexiParseError(res, "unexpected token in list");
-		}
-
-		elems.emplace_back(expr);
 	}
 
-	if(delimIt == end){
-		for(auto elem : elems){ sexiDestroyExpr(elem); }
-		return sexiParseError(res, "unexpected end of source in list");
-	}
+	auto node = const_cast<SexiExpr>(list);
+	auto ctx = node->lazyCtx;
+	auto text = node->str;
+
+	// the lists of a result share the memory they're built in
+	std::lock_guard ctxLock(ctx->mutex);
 
-	auto &&elemVec = res->storage.emplace_back(std::move(elems));
+	auto &scratch = ctx->scratch;
+	scratch.exprs.clear();
+	scratch.src = text.ptr;
 
-	auto listExpr = sexiCreateList(elemVec.size(), elemVec.data());
+	// the text was checked by the parse, so only running out of memory fails here
+	const bool built = parseExprs(&scratch, text.ptr, text.ptr + text.len, ctx->opts, ctx->stacks) && scratch.exprs.size() == 1;
 
-	return std::make_tuple(it, listExpr);
+	scratch.hasError = false;
+	scratch.errors.clear();
+
+	// the list stays unbuilt for the next access to try again, the result remembers the failure
+	if(!built){
+		ctx->failed.store(true, std::memory_order_release);
+		storeLazyState(node, lazyPending);
+		return false;
+	}
+
+	node->list = scratch.exprs.front()->list;
+	node->hash = 0;
+	storeLazyState(node, lazyExpanded);
+	return true;
 }
 
-SexiParseResult sexiParse(size_t len, const char *ptr, bool copyStrs){
-	auto mem = std::malloc(sizeof(SexiParseResultT));
+SexiParseResult sexi::detail::createParseResult(const SexiParseOptions &opts) noexcept{
+	auto alloc = resolveAllocator(opts.allocator);
+
+	auto mem = allocate(alloc, sizeof(SexiParseResultT));
 	if(!mem) return nullptr;
 
-	auto ret = new(mem) SexiParseResultT;
-	ret->hasError = false;
+	return new(mem) SexiParseResultT(alloc);
+}
 
-	const char *it = ptr;
-	const char *end = ptr + len;
+SexiStr sexiParseEvents(size_t len, const char *ptr, const SexiParseEvents *events, void *user, const SexiParseOptions *opts){
+	const auto &walkOpts = opts ? *opts : defaultParseOpts;
 
-	SexiExpr expr = nullptr;
+	EventForwarder forwarder(*events, user, ptr);
+	walkExprs(ptr, ptr + len, walkOpts.maxDepth, forwarder);
 
-	while(it != end){
-		if(*it == '('){
-			// parse a list
-			std::tie(it, expr) = sexiParseList(ret, it, end, copyStrs);
-			if(!it) return ret;
-		}
-		else if(std::isspace(*it)){
-			++it;
-			continue;
-		}
-		else{
-			ret->hasError = true;
-			ret->err = "unexpected token at top level";
-			return ret;
-		}
+	auto err = forwarder.err();
+	return { .len = err.size(), .ptr = err.data() };
+}
+
+SexiParseResult sexiParseEx(size_t len, const char *ptr, const SexiParseOptions *opts){
+	const auto &parseOpts = opts ? *opts : defaultParseOpts;
+
+	auto ret = createParseResult(parseOpts);
+	if(!ret) return nullptr;
+
+	parseExprsParallel(ret, ptr, ptr + len, parseOpts);
+
+	return ret;
+}
+
+SexiParseResult sexiParseFile(const char *path, const SexiParseOptions *opts){
+	// the mapping lives as long as the result, so nothing needs copying out of it
+	auto fileOpts = opts ? *opts : defaultParseOpts;
+	fileOpts.copyStrs = false;
 
-		ret->exprs.emplace_back(expr);
+	auto ret = createParseResult(fileOpts);
+	if(!ret) return nullptr;
+
+	auto err = ret->file.open(path);
+	if(!err.empty()){
+		sexiParseError(ret, err);
+		return ret;
 	}
 
+	auto beg = ret->file.data();
+	parseExprsParallel(ret, beg, beg + ret->file.size(), fileOpts);
+
 	return ret;
 }
+
+SexiParseResult sexiParse(size_t len, const char *ptr, bool copyStrs){
+	const SexiParseOptions opts = { .copyStrs = copyStrs, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+	return sexiParseEx(len, ptr, &opts);
+}
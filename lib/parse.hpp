@@ -0,0 +1,106 @@
+#ifndef SEXI_PARSE_HPP
+#define SEXI_PARSE_HPP 1
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "sexi.h"
+
+#include "Alloc.hpp"
+#include "Expr.hpp"
+#include "Locations.hpp"
+#include "MappedFile.hpp"
+#include "Symbols.hpp"
+
+namespace sexi::detail{
+	struct LazyContextDeleter{
+		const SexiAllocator *alloc;
+		void operator()(LazyContext *ctx) const noexcept;
+	};
+}
+
+struct SexiParseResultT{
+	explicit SexiParseResultT(const SexiAllocator *alloc = nullptr) noexcept
+		: alloc(sexi::detail::resolveAllocator(alloc)), hasError(false), hasErrorPos(false)
+		, errors(sexi::detail::StlAllocator<SexiParseErrorInfo>(this->alloc)), src(nullptr)
+		, exprs(sexi::detail::StlAllocator<SexiExpr>(this->alloc)), arena(this->alloc)
+		, chunkArenas(sexi::detail::StlAllocator<sexi::detail::Arena>(this->alloc)), locations(this->alloc)
+		, lazy(nullptr), lazyOwner(nullptr, { this->alloc }){}
+
+	const SexiAllocator *alloc; // allocator of the result itself and everything it owns
+	bool hasError;
+	std::string_view err;
+	bool hasErrorPos; // whether `err` is the first of `errors`
+	sexi::detail::Vector<SexiParseErrorInfo> errors; // every error in the source, lines are worked out once the parse is over
+	const char *src; // start of the whole source, what offsets are relative to
+	sexi::detail::Vector<SexiExpr> exprs;
+	sexi::detail::Arena arena; // owns every expression, child array and copied string of the parse
+	sexi::detail::MappedFile file; // source of sexiParseFile, referenced by the expressions
+	sexi::detail::Vector<sexi::detail::Arena> chunkArenas; // arenas of the other chunks of a parallel parse
+	sexi::detail::LocationTable locations; // only filled when parsing with `locations`
+	sexi::detail::LazyContext *lazy; // builds the lists left by `lazyDepth` , shared by the chunks of a parallel parse
+	std::unique_ptr<sexi::detail::LazyContext, sexi::detail::LazyContextDeleter> lazyOwner; // only set in the result handed out
+};
+
+namespace sexi::detail{
+	/**
+	 * @brief Working memory of \ref parseExprs , reusable between parses.
+	 */
+	struct ParseStacks{
+		std::vector<SexiExpr> elems; // elements of every open list, each list only owns the top
+		std::vector<std::size_t> frames; // offset in `elems` of the first element of each open list
+		std::vector<const char*> listBegins; // open paren of each open list, only kept when recording locations
+		SymbolCache symbols; // only filled when interning ids
+	};
+
+	/**
+	 * @brief What lists left unbuilt by a lazy parse are built with, see \ref expandList .
+	 */
+	struct LazyContext{
+		LazyContext(const SexiAllocator *alloc, const SexiParseOptions &parseOpts) noexcept;
+
+		std::mutex mutex; // lists of one result are built one at a time
+		std::atomic<bool> failed{false}; // some list couldn't be built, which the result reports as its error
+		SexiParseResultT scratch; // its arena owns every list built
+		ParseStacks stacks;
+		SexiParseOptions opts;
+	};
+
+	/**
+	 * @brief Set up \p res for the `lazyDepth` of \p opts , if any.
+	 * @returns whether there was memory for it, otherwise the error is set in \p res
+	 */
+	bool initLazy(SexiParseResult res, const SexiParseOptions &opts) noexcept;
+
+	inline constexpr SexiParseOptions defaultParseOpts = { .copyStrs = true, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+	/**
+	 * @brief Parse every expression in `[beg, end)` , appending them to the exprs of \p res .
+	 * Error positions and spans are relative to `res->src` , which must be set.
+	 * @returns whether parsing succeeded, otherwise the error is set in \p res
+	 */
+	bool parseExprs(SexiParseResult res, const char *beg, const char *end, const SexiParseOptions &opts, ParseStacks &stacks);
+
+	/**
+	 * @brief Create an empty parse result in memory from `opts.allocator` .
+	 * @returns the result or `nullptr` if it couldn't be allocated
+	 */
+	SexiParseResult createParseResult(const SexiParseOptions &opts) noexcept;
+
+	inline bool parseExprs(SexiParseResult res, const char *beg, const char *end, const SexiParseOptions &opts){
+		ParseStacks stacks;
+		return parseExprs(res, beg, end, opts, stacks);
+	}
+
+	/**
+	 * @brief Same as \ref parseExprs , but splits large sources between `opts.numThreads` threads.
+	 * Falls back to parsing on the calling thread when splitting isn't worth it.
+	 * Sets `res->src` to \p beg and works out the line and column of any error.
+	 */
+	bool parseExprsParallel(SexiParseResult res, const char *beg, const char *end, const SexiParseOptions &opts);
+}
+
+#endif // !SEXI_PARSE_HPP
@@ -0,0 +1,291 @@
+#include <cstring>
+
+#include "scan.hpp"
+#include "chars.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SEXI_SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEXI_SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+
+using namespace sexi::detail;
+
+// the fallback when no vector kernel is compiled in, always built so it's tested against the others
+static BlockMasks classifyScalar(const char *block) noexcept{
+	BlockMasks ret = { 0, 0, 0, 0, 0 };
+
+	for(unsigned i = 0; i < StructuralScanner::blockSize; i++){
+		auto c = block[i];
+		auto bit = std::uint64_t(1) << i;
+
+		switch(c){
+			case '(': ret.open |= bit; break;
+			case ')': ret.close |= bit; break;
+			case '"': ret.quote |= bit; break;
+			case '\\': ret.backslash |= bit; break;
+			default:
+				if(charIs(c, CHAR_SPACE)) ret.ws |= bit;
+				break;
+		}
+	}
+
+	return ret;
+}
+
+static std::size_t countNewlinesScalar(const char *beg, const char *end) noexcept{
+	std::size_t ret = 0;
+	for(; beg != end; ++beg) ret += *beg == '\n';
+	return ret;
+}
+
+#ifdef SEXI_SCAN_SSE2
+static BlockMasks classifySse2(const char *block) noexcept{
+	BlockMasks ret = { 0, 0, 0, 0, 0 };
+
+	const auto open = _mm_set1_epi8('('), close = _mm_set1_epi8(')');
+	const auto quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+	const auto space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+	const auto ctrlRange = _mm_set1_epi8('\r' - '\t');
+
+	for(unsigned i = 0; i < 4; i++){
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + (i * 16)));
+		auto shift = i * 16;
+
+		// '\t'..'\r' is contiguous, so one unsigned range check covers it
+		auto ctrl = _mm_sub_epi8(v, tab);
+		auto isCtrlWs = _mm_cmpeq_epi8(_mm_min_epu8(ctrl, ctrlRange), ctrl);
+		auto isWs = _mm_or_si128(_mm_cmpeq_epi8(v, space), isCtrlWs);
+
+		ret.open |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, open)))) << shift;
+		ret.close |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, close)))) << shift;
+		ret.quote |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+		ret.backslash |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+		ret.ws |= std::uint64_t(std::uint16_t(_mm_movemask_epi8(isWs))) << shift;
+	}
+
+	return ret;
+}
+
+static std::size_t countNewlinesSse2(const char *beg, const char *end) noexcept{
+	const auto newline = _mm_set1_epi8('\n');
+	std::size_t ret = 0;
+
+	// matches subtract 1 from per-byte counters, which are summed before they can wrap
+	while(end - beg >= 16){
+		auto counts = _mm_setzero_si128();
+
+		for(unsigned i = 0; i < 255 && end - beg >= 16; i++, beg += 16){
+			auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(beg));
+			counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(v, newline));
+		}
+
+		auto sums = _mm_sad_epu8(counts, _mm_setzero_si128());
+		ret += std::size_t(_mm_cvtsi128_si32(sums)) + std::size_t(_mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums)));
+	}
+
+	return ret + countNewlinesScalar(beg, end);
+}
+#endif
+
+#ifdef SEXI_SCAN_AVX2
+__attribute__((target("avx2")))
+static BlockMasks classifyAvx2(const char *block) noexcept{
+	BlockMasks ret = { 0, 0, 0, 0, 0 };
+
+	const auto open = _mm256_set1_epi8('('), close = _mm256_set1_epi8(')');
+	const auto quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\');
+	const auto space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+	const auto ctrlRange = _mm256_set1_epi8('\r' - '\t');
+
+	for(unsigned i = 0; i < 2; i++){
+		auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + (i * 32)));
+		auto shift = i * 32;
+
+		auto ctrl = _mm256_sub_epi8(v, tab);
+		auto isCtrlWs = _mm256_cmpeq_epi8(_mm256_min_epu8(ctrl, ctrlRange), ctrl);
+		auto isWs = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), isCtrlWs);
+
+		ret.open |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, open)))) << shift;
+		ret.close |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, close)))) << shift;
+		ret.quote |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << shift;
+		ret.backslash |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)))) << shift;
+		ret.ws |= std::uint64_t(std::uint32_t(_mm256_movemask_epi8(isWs))) << shift;
+	}
+
+	return ret;
+}
+
+__attribute__((target("avx2")))
+static std::size_t countNewlinesAvx2(const char *beg, const char *end) noexcept{
+	const auto newline = _mm256_set1_epi8('\n');
+	std::size_t ret = 0;
+
+	while(end - beg >= 32){
+		auto counts = _mm256_setzero_si256();
+
+		for(unsigned i = 0; i < 255 && end - beg >= 32; i++, beg += 32){
+			auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(beg));
+			counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(v, newline));
+		}
+
+		auto sums = _mm256_sad_epu8(counts, _mm256_setzero_si256());
+		auto halves = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+		ret += std::size_t(_mm_cvtsi128_si32(halves)) + std::size_t(_mm_cvtsi128_si32(_mm_unpackhi_epi64(halves, halves)));
+	}
+
+	return ret + countNewlinesScalar(beg, end);
+}
+#endif
+
+// ordered from the slowest to the fastest
+struct ClassifyKernels{
+	ClassifyKernel kernels[3];
+	std::size_t n = 0;
+};
+
+static ClassifyKernels selectKernels() noexcept{
+	ClassifyKernels ret;
+	ret.kernels[ret.n++] = { classifyScalar, countNewlinesScalar, "scalar" };
+
+#ifdef SEXI_SCAN_SSE2
+	ret.kernels[ret.n++] = { classifySse2, countNewlinesSse2, "sse2" };
+#endif
+
+#ifdef SEXI_SCAN_AVX2
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) ret.kernels[ret.n++] = { classifyAvx2, countNewlinesAvx2, "avx2" };
+#endif
+
+	return ret;
+}
+
+static const ClassifyKernels &allKernels() noexcept{
+	static const ClassifyKernels ret = selectKernels();
+	return ret;
+}
+
+static const ClassifyKernel &kernel() noexcept{
+	static const ClassifyKernel ret = allKernels().kernels[allKernels().n - 1];
+	return ret;
+}
+
+const ClassifyKernel *sexi::detail::classifyKernels(std::size_t &n) noexcept{
+	n = allKernels().n;
+	return allKernels().kernels;
+}
+
+BlockMasks sexi::detail::classifyBlock(const char *block) noexcept{
+	return kernel().classify(block);
+}
+
+std::size_t sexi::detail::countNewlines(const char *beg, const char *end) noexcept{
+	return kernel().countNewlines(beg, end);
+}
+
+const char *sexi::detail::classifyKernelName() noexcept{
+	return kernel().name;
+}
+
+// bit i of the result is set if non-backslash character i follows an odd run of backslashes
+static inline std::uint64_t findEscaped(std::uint64_t backslash, std::uint64_t &prevEndsOdd) noexcept{
+	constexpr std::uint64_t evenBits = 0x5555555555555555ULL;
+	constexpr std::uint64_t oddBits = ~evenBits;
+
+	if(!backslash){
+		auto ret = prevEndsOdd;
+		prevEndsOdd = 0;
+		return ret;
+	}
+
+	auto startEdges = backslash & ~(backslash << 1);
+
+	// an odd run carried in from the last block flips the parity of a run starting at bit 0
+	auto evenStartMask = evenBits ^ prevEndsOdd;
+	auto evenStarts = startEdges & evenStartMask;
+	auto oddStarts = startEdges & ~evenStartMask;
+
+	auto evenCarries = backslash + evenStarts;
+	auto oddCarries = backslash + oddStarts;
+	auto endsOdd = oddCarries < backslash;
+
+	oddCarries |= prevEndsOdd;
+	prevEndsOdd = endsOdd ? 1 : 0;
+
+	auto evenCarryEnds = evenCarries & ~backslash;
+	auto oddCarryEnds = oddCarries & ~backslash;
+
+	return (evenCarryEnds & oddBits) | (oddCarryEnds & evenBits);
+}
+
+// bit i of the result is the xor of bits 0..i of the input
+static inline std::uint64_t prefixXor(std::uint64_t bits) noexcept{
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return bits;
+}
+
+// unescaped quotes, and the mask of string contents from each opening quote up to its closing quote
+static inline std::uint64_t findStrs(const BlockMasks &masks, ScanState &state, std::uint64_t &inStr) noexcept{
+	auto escaped = findEscaped(masks.backslash, state.prevEscaped);
+	auto quotes = masks.quote & ~escaped;
+
+	inStr = prefixXor(quotes) ^ state.prevInStr;
+	state.prevInStr = std::uint64_t(std::int64_t(inStr) >> 63);
+
+	return quotes;
+}
+
+ParenMasks sexi::detail::scanParens(const char *block, ScanState &state) noexcept{
+	auto masks = classifyBlock(block);
+
+	std::uint64_t inStr;
+	findStrs(masks, state, inStr);
+
+	return { masks.open & ~inStr, masks.close & ~inStr };
+}
+
+std::uint64_t sexi::detail::scanBlock(const char *block, ScanState &state) noexcept{
+	return scanMasks(classifyBlock(block), state);
+}
+
+std::uint64_t sexi::detail::scanMasks(const BlockMasks &masks, ScanState &state) noexcept{
+	std::uint64_t inStr;
+	auto quotes = findStrs(masks, state, inStr);
+
+	auto tokChar = ~(masks.ws | masks.open | masks.close | quotes | inStr);
+	auto tokStart = tokChar & ~((tokChar << 1) | state.prevTokChar);
+	state.prevTokChar = tokChar >> 63;
+
+	return quotes | ((masks.open | masks.close | tokStart) & ~inStr);
+}
+
+bool StructuralScanner::refill() noexcept{
+	if(m_nextOffset >= m_len) return false;
+
+	m_blockOffset = m_nextOffset;
+	m_nextOffset += blockSize;
+
+	auto remaining = m_len - m_blockOffset;
+
+	if(remaining >= blockSize){
+		m_bits = scanBlock(m_beg + m_blockOffset, m_state);
+	}
+	else{
+		// pad the tail with whitespace so it can't produce structurals
+		char tail[blockSize];
+		std::memset(tail, ' ', blockSize);
+		std::memcpy(tail, m_beg + m_blockOffset, remaining);
+		m_bits = scanBlock(tail, m_state);
+	}
+
+	return true;
+}
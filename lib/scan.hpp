@@ -0,0 +1,148 @@
+#ifndef SEXI_SCAN_HPP
+#define SEXI_SCAN_HPP 1
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace sexi::detail{
+	inline unsigned countTrailingZeros(std::uint64_t bits) noexcept{
+#ifdef _MSC_VER
+		unsigned long ret;
+		_BitScanForward64(&ret, bits);
+		return unsigned(ret);
+#else
+		return unsigned(__builtin_ctzll(bits));
+#endif
+	}
+
+	inline unsigned countOnes(std::uint64_t bits) noexcept{
+#ifdef _MSC_VER
+		return unsigned(__popcnt64(bits));
+#else
+		return unsigned(__builtin_popcountll(bits));
+#endif
+	}
+
+	/**
+	 * @brief Per-character masks of a 64 byte block, bit `i` describing byte `i`.
+	 */
+	struct BlockMasks{
+		std::uint64_t open, close, quote, backslash, ws;
+	};
+
+	/**
+	 * @brief Classify exactly 64 bytes starting at \p block .
+	 * Dispatches once to the widest kernel the CPU supports.
+	 */
+	BlockMasks classifyBlock(const char *block) noexcept;
+
+	/**
+	 * @brief Count the newlines in `[beg, end)` , with the same kernel as \ref classifyBlock .
+	 */
+	std::size_t countNewlines(const char *beg, const char *end) noexcept;
+
+	/**
+	 * @brief Name of the kernel picked by \ref classifyBlock , for diagnostics.
+	 */
+	const char *classifyKernelName() noexcept;
+
+	/**
+	 * @brief One way of classifying blocks and counting newlines.
+	 */
+	struct ClassifyKernel{
+		BlockMasks(*classify)(const char *block) noexcept;
+		std::size_t(*countNewlines)(const char *beg, const char *end) noexcept;
+		const char *name;
+	};
+
+	/**
+	 * @brief Every kernel compiled in that the CPU can run, so they can be checked against each other.
+	 * The portable scalar kernel comes first, the one \ref classifyBlock picked last.
+	 * @param[out] n number of kernels
+	 */
+	const ClassifyKernel *classifyKernels(std::size_t &n) noexcept;
+
+	/**
+	 * @brief State carried from one block to the next by \ref scanBlock .
+	 */
+	struct ScanState{
+		std::uint64_t prevEscaped = 0, prevInStr = 0, prevTokChar = 0;
+	};
+
+	/**
+	 * @brief Find the structural characters of exactly 64 bytes starting at \p block .
+	 * Bit `i` of the result is set if byte `i` is structural. The structural
+	 * status of a byte only depends on the bytes before it, so a partial block
+	 * padded with whitespace yields exact bits for the bytes it does contain.
+	 * @param block the bytes to scan
+	 * @param state state at the start of the block, updated to the state at its end
+	 * @returns mask of structural characters
+	 */
+	std::uint64_t scanBlock(const char *block, ScanState &state) noexcept;
+
+	/**
+	 * @brief \ref scanBlock from the masks of a block that is already classified.
+	 */
+	std::uint64_t scanMasks(const BlockMasks &masks, ScanState &state) noexcept;
+
+	/**
+	 * @brief Parens outside of strings in a 64 byte block.
+	 */
+	struct ParenMasks{
+		std::uint64_t open, close;
+	};
+
+	/**
+	 * @brief Find only the parens of exactly 64 bytes starting at \p block .
+	 * Cheaper than \ref scanBlock when nesting is all that matters. Token starts
+	 * aren't tracked, so \p state must not be shared with \ref scanBlock .
+	 * @param block the bytes to scan
+	 * @param state state at the start of the block, updated to the state at its end
+	 */
+	ParenMasks scanParens(const char *block, ScanState &state) noexcept;
+
+	/**
+	 * @brief Stage one of parsing: finds structural characters 64 bytes at a time.
+	 *
+	 * Structural characters are parens and unescaped quotes outside of strings
+	 * plus the first character of every id or number. Everything between an
+	 * opening and closing quote is skipped, so the tree builder only ever
+	 * touches bytes that matter.
+	 */
+	class StructuralScanner{
+		public:
+			static constexpr std::size_t blockSize = 64;
+
+			StructuralScanner(const char *beg, const char *end) noexcept
+				: m_beg(beg), m_len(std::size_t(end - beg)), m_blockOffset(0), m_nextOffset(0), m_bits(0){}
+
+			/**
+			 * @brief Get the next structural character.
+			 * @param[out] pos pointer to the character
+			 * @returns whether there was another structural character
+			 */
+			bool next(const char *&pos) noexcept{
+				while(!m_bits){
+					if(!refill()) return false;
+				}
+
+				pos = m_beg + m_blockOffset + countTrailingZeros(m_bits);
+				m_bits &= m_bits - 1;
+				return true;
+			}
+
+		private:
+			bool refill() noexcept;
+
+			const char *m_beg;
+			std::size_t m_len, m_blockOffset, m_nextOffset;
+			std::uint64_t m_bits;
+			ScanState m_state;
+	};
+}
+
+#endif // !SEXI_SCAN_HPP
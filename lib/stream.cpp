@@ -0,0 +1,197 @@
+#include <cstdlib>
+#include <cstring>
+
+#include <memory>
+#include <string>
+
+#include "parse.hpp"
+#include "scan.hpp"
+#include "chars.hpp"
+
+using namespace sexi::detail;
+
+struct SexiParserT{
+	explicit SexiParserT(const SexiAllocator *alloc) noexcept
+		: res(alloc), buf(StlAllocator<char>(res.alloc)){}
+
+	SexiParseOptions opts;
+	SexiParserFn fn;
+	void *user;
+
+	// reused for every top-level expression, its error is the error of the parser
+	SexiParseResultT res;
+	ParseStacks stacks;
+
+	String buf; // input not yet consumed, starting at the current top-level expression
+	std::size_t scanPos; // offset of the first block not yet scanned to completion
+	std::size_t handledPos; // offset of the first byte whose structural bit hasn't been handled
+	std::size_t formStart; // offset of the open paren of the current top-level expression
+	std::size_t depth;
+	ScanState scanState; // state at `scanPos`
+};
+
+static bool sexiParserFail(SexiParser parser, std::string_view msg){
+	parser->res.hasError = true;
+	parser->res.err = msg;
+	return false;
+}
+
+static void sexiParserReset(SexiParser parser){
+	parser->buf.clear();
+	parser->scanPos = parser->handledPos = parser->formStart = 0;
+	parser->depth = 0;
+	parser->scanState = ScanState{};
+}
+
+// parse the completed top-level expression ending at `closePos` and hand it to the callback
+static bool sexiParserEmit(SexiParser parser, std::size_t closePos){
+	auto res = &parser->res;
+	auto beg = parser->buf.data() + parser->formStart;
+	auto end = parser->buf.data() + closePos + 1;
+
+	res->src = beg;
+
+	if(parseExprs(res, beg, end, parser->opts, parser->stacks)){
+		for(auto expr : res->exprs){
+			parser->fn(parser->user, expr);
+		}
+	}
+
+	res->exprs.clear();
+	res->arena.reset();
+
+	return !res->hasError;
+}
+
+// track nesting of the structurals in one block, only bits at or after `handledPos` are new
+static bool sexiParserHandle(SexiParser parser, std::size_t blockPos, std::uint64_t bits){
+	const auto maxDepth = parser->opts.maxDepth;
+
+	while(bits){
+		auto pos = blockPos + countTrailingZeros(bits);
+		bits &= bits - 1;
+
+		if(pos < parser->handledPos) continue;
+
+		parser->handledPos = pos + 1;
+
+		auto c = parser->buf[pos];
+
+		if(c == '('){
+			if(maxDepth && parser->depth == maxDepth){
+				return sexiParserFail(parser, "maximum nesting depth exceeded");
+			}
+
+			if(parser->depth++ == 0){
+				parser->formStart = pos;
+			}
+		}
+		else if(parser->depth == 0){
+			return sexiParserFail(parser, "unexpected token at top level");
+		}
+		else if(c == ')' && --parser->depth == 0){
+			if(!sexiParserEmit(parser, pos)) return false;
+		}
+	}
+
+	return true;
+}
+
+SexiParser sexiParserCreate(const SexiParseOptions *opts, SexiParserFn fn, void *user){
+	const auto &parserOpts = opts ? *opts : defaultParseOpts;
+	auto alloc = resolveAllocator(parserOpts.allocator);
+
+	auto mem = allocate(alloc, sizeof(SexiParserT));
+	if(!mem) return nullptr;
+
+	auto ret = new(mem) SexiParserT(alloc);
+	ret->opts = parserOpts;
+	ret->fn = fn;
+	ret->user = user;
+
+	// expressions never outlive the buffer they are parsed from, which moves as it's consumed
+	ret->opts.copyStrs = false;
+	ret->opts.locations = false;
+	ret->opts.recover = false;
+	ret->opts.lazyDepth = 0;
+
+	sexiParserReset(ret);
+	return ret;
+}
+
+void sexiParserDestroy(SexiParser parser){
+	auto alloc = parser->res.alloc;
+	std::destroy_at(parser);
+	deallocate(alloc, parser);
+}
+
+bool sexiParserHasError(SexiParser parser){ return parser->res.hasError; }
+SexiStr sexiParserError(SexiParser parser){ return { .len = parser->res.err.size(), .ptr = parser->res.err.data() }; }
+
+bool sexiParserFeed(SexiParser parser, size_t len, const char *ptr){
+	if(parser->res.hasError) return false;
+
+	constexpr auto blockSize = StructuralScanner::blockSize;
+
+	try{
+		parser->buf.append(ptr, len);
+	}
+	catch(const std::bad_alloc&){
+		return sexiParserFail(parser, "failed to allocate memory");
+	}
+
+	auto &buf = parser->buf;
+
+	while(buf.size() - parser->scanPos >= blockSize){
+		auto bits = scanBlock(buf.data() + parser->scanPos, parser->scanState);
+		if(!sexiParserHandle(parser, parser->scanPos, bits)) return false;
+		parser->scanPos += blockSize;
+	}
+
+	auto remaining = buf.size() - parser->scanPos;
+	if(remaining){
+		// the bits of a partial block are final, only its carried state has to wait for the rest
+		char tail[blockSize];
+		std::memset(tail, ' ', blockSize);
+		std::memcpy(tail, buf.data() + parser->scanPos, remaining);
+
+		auto state = parser->scanState;
+		auto bits = scanBlock(tail, state);
+		if(!sexiParserHandle(parser, parser->scanPos, bits)) return false;
+	}
+
+	// drop everything before the current top-level expression, keeping the partial block
+	auto keepPos = parser->scanPos;
+	if(parser->depth && parser->formStart < keepPos) keepPos = parser->formStart;
+
+	if(keepPos){
+		buf.erase(0, keepPos);
+		parser->scanPos -= keepPos;
+		parser->handledPos = parser->handledPos > keepPos ? parser->handledPos - keepPos : 0;
+		if(parser->depth) parser->formStart -= keepPos;
+	}
+
+	return true;
+}
+
+bool sexiParserFinish(SexiParser parser){
+	if(parser->res.hasError) return false;
+
+	if(parser->depth){
+		// re-parse the incomplete expression so the error matches sexiParse
+		auto res = &parser->res;
+		auto beg = parser->buf.data() + parser->formStart;
+		res->src = beg;
+
+		if(parseExprs(res, beg, parser->buf.data() + parser->buf.size(), parser->opts, parser->stacks)){
+			sexiParserFail(parser, "unexpected end of source in list");
+		}
+
+		res->exprs.clear();
+		res->arena.reset();
+		return false;
+	}
+
+	sexiParserReset(parser);
+	return true;
+}
@@ -0,0 +1,170 @@
+#ifndef SEXI_WALK_HPP
+#define SEXI_WALK_HPP 1
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "sexi/Expr.h"
+
+#include "scan.hpp"
+#include "chars.hpp"
+
+namespace sexi::detail{
+	/**
+	 * @brief Message of a malformed token and the character it was noticed at.
+	 */
+	struct TokenError{
+		std::string_view msg;
+		const char *at;
+	};
+
+	// ids and numbers end at whitespace or a paren, quotes may only delimit whole strings
+
+	inline const char *scanId(const char *beg, const char *end, TokenError &err) noexcept{
+		auto it = skipChars(beg + 1, end, CHAR_ID);
+
+		if(it == end){
+			err = { "unexpected end of source in id", it };
+			return nullptr;
+		}
+		else if(!charIs(*it, CHAR_TOKEN_END)){
+			err = { "unexpected character in identifier", it };
+			return nullptr;
+		}
+
+		return it;
+	}
+
+	inline const char *scanStr(const char *closeIt, const char *end, TokenError &err) noexcept{
+		auto it = closeIt + 1;
+
+		// check delimiter
+
+		if(it != end && *it != ')' && !charIs(*it, CHAR_SPACE)){
+			err = { "unexpected character in string", it };
+			return nullptr;
+		}
+
+		return it;
+	}
+
+	inline const char *scanNum(const char *beg, const char *end, TokenError &err) noexcept{
+		auto it = skipChars(beg + 1, end, CHAR_ALNUM);
+
+		if(it != end && *it == '.'){
+			it = skipChars(it + 1, end, CHAR_ALNUM);
+
+			if(it != end && *it == '.'){
+				err = { "multiple decimal points in number", it };
+				return nullptr;
+			}
+		}
+
+		if(it == end){
+			err = { "unexpected end of source in number", it };
+			return nullptr;
+		}
+		else if(!charIs(*it, CHAR_TOKEN_END)){
+			err = { "unexpected character in number", it };
+			return nullptr;
+		}
+
+		return it;
+	}
+
+	inline SexiStr tokenStr(const char *beg, const char *end) noexcept{
+		return { .len = std::size_t(end - beg), .ptr = beg };
+	}
+
+	/**
+	 * @brief Check the structure of `[beg, end)` and report every token to \p handler in source order.
+	 *
+	 * Nothing is allocated, everything beyond tracking the nesting depth is up
+	 * to \p handler , which needs these members:
+	 *  - `bool listBegin(const char *it)` and `bool listEnd(const char *it)` for parens
+	 *  - `bool id(SexiStr)`, `bool str(SexiStr)` and `bool num(SexiStr)` for tokens exactly as written
+	 *  - `void error(std::string_view msg, const char *at)` for errors in the source, \p at
+	 *    pointing at the offending character or at \p end
+	 *
+	 * Returning `false` from any token member stops the walk.
+	 * @param maxDepth maximum list nesting depth, or 0 for no limit
+	 * @returns whether the whole source was walked
+	 */
+	template<typename Handler>
+	bool walkExprs(const char *beg, const char *end, std::size_t maxDepth, Handler &handler){
+		// only visit parens, quotes and the first character of each id or number
+		StructuralScanner scanner(beg, end);
+
+		const char *it = nullptr;
+		std::size_t depth = 0;
+		TokenError err;
+
+		while(scanner.next(it)){
+			if(*it == '('){
+				if(maxDepth && depth == maxDepth){
+					handler.error("maximum nesting depth exceeded", it);
+					return false;
+				}
+
+				++depth;
+				if(!handler.listBegin(it)) return false;
+			}
+			else if(depth == 0){
+				handler.error("unexpected token at top level", it);
+				return false;
+			}
+			else if(*it == ')'){
+				--depth;
+				if(!handler.listEnd(it)) return false;
+			}
+			else if(*it == '"'){
+				// the scanner skips string contents, so the next structural is the closing quote
+				const char *closeIt = nullptr;
+				if(!scanner.next(closeIt)){
+					handler.error("unexpected end of source in string", end);
+					return false;
+				}
+
+				auto tokEnd = scanStr(closeIt, end, err);
+				if(!tokEnd){
+					handler.error(err.msg, err.at);
+					return false;
+				}
+
+				if(!handler.str(tokenStr(it, tokEnd))) return false;
+			}
+			else if(charIs(*it, CHAR_DIGIT)){
+				auto tokEnd = scanNum(it, end, err);
+				if(!tokEnd){
+					handler.error(err.msg, err.at);
+					return false;
+				}
+
+				if(!handler.num(tokenStr(it, tokEnd))) return false;
+			}
+			else if(charIs(*it, CHAR_ID_START)){
+				auto tokEnd = scanId(it, end, err);
+				if(!tokEnd){
+					handler.error(err.msg, err.at);
+					return false;
+				}
+
+				if(!handler.id(tokenStr(it, tokEnd))) return false;
+			}
+			else{
+				handler.error("unexpected token in list", it);
+				return false;
+			}
+		}
+
+		if(depth){
+			handler.error("unexpected end of source in list", end);
+			return false;
+		}
+
+		return true;
+	}
+}
+
+#endif // !SEXI_WALK_HPP
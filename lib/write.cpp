@@ -0,0 +1,176 @@
+#include <cerrno>
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include "Expr.hpp"
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#define SEXI_WRITE_FD(fd, ptr, len) ::write(fd, ptr, len)
+#elif __has_include(<io.h>)
+#include <io.h>
+#define SEXI_WRITE_FD(fd, ptr, len) ::_write(fd, ptr, unsigned(len))
+#endif
+
+namespace {
+	// lists nested deeper than this spill their frames onto the heap
+	constexpr std::size_t inlineFrames = 64;
+
+	struct WriteFrame{
+		SexiExprConst list;
+		std::size_t idx;
+	};
+
+	// write the text of `expr` to `out` in one pass, without recursing
+	template<typename Out>
+	bool writeExpr(SexiExprConst expr, Out &out){
+		WriteFrame inlineStack[inlineFrames];
+		std::vector<WriteFrame> heapStack;
+		std::size_t depth = 0;
+
+		auto push = [&](SexiExprConst list){
+			if(depth < inlineFrames){
+				inlineStack[depth] = { list, 0 };
+			}
+			else{
+				heapStack.push_back({ list, 0 });
+			}
+
+			++depth;
+		};
+
+		auto top = [&]() -> WriteFrame&{
+			return depth <= inlineFrames ? inlineStack[depth - 1] : heapStack.back();
+		};
+
+		auto pop = [&]{
+			if(depth > inlineFrames) heapStack.pop_back();
+			--depth;
+		};
+
+		while(true){
+			if(expr->type == SEXI_LIST){
+				if(!out.put("(", 1)) return false;
+				if(!sexi::detail::forceList(expr)) return false;
+				push(expr);
+			}
+			else{
+				auto str = expr->type == SEXI_EMPTY ? SexiStr{ .len = 2, .ptr = "()" } : expr->str;
+				if(!out.put(str.ptr, str.len)) return false;
+			}
+
+			// climb out of every finished list, then move on to the next element
+			while(depth){
+				auto &frame = top();
+				if(frame.idx != frame.list->list.n) break;
+
+				if(!out.put(")", 1)) return false;
+				pop();
+			}
+
+			if(!depth) return true;
+
+			auto &frame = top();
+			if(frame.idx != 0 && !out.put(" ", 1)) return false;
+
+			expr = frame.list->list.exprs[frame.idx++];
+		}
+	}
+
+	// copies as much as fits, counting everything
+	struct BufferOut{
+		char *buf;
+		std::size_t cap, len;
+
+		bool put(const char *ptr, std::size_t n) noexcept{
+			if(len < cap){
+				auto room = cap - len;
+				std::memcpy(buf + len, ptr, n < room ? n : room);
+			}
+
+			len += n;
+			return true;
+		}
+	};
+
+	// batches small writes into chunks before handing them on
+	template<typename Flush>
+	struct ChunkOut{
+		static constexpr std::size_t chunkSize = 4096;
+
+		Flush flush;
+		char chunk[chunkSize];
+		std::size_t len = 0;
+
+		explicit ChunkOut(Flush flush_)
+			: flush(flush_){}
+
+		bool put(const char *ptr, std::size_t n){
+			if(len + n > chunkSize){
+				if(!drain()) return false;
+
+				if(n > chunkSize) return flush(ptr, n);
+			}
+
+			std::memcpy(chunk + len, ptr, n);
+			len += n;
+			return true;
+		}
+
+		bool drain(){
+			if(!len) return true;
+
+			auto ok = flush(chunk, len);
+			len = 0;
+			return ok;
+		}
+	};
+
+	template<typename Flush>
+	bool writeChunked(SexiExprConst expr, Flush flush){
+		ChunkOut<Flush> out(flush);
+		return writeExpr(expr, out) && out.drain();
+	}
+}
+
+size_t sexiExprWrite(SexiExprConst expr, char *buf, size_t cap){
+	BufferOut out{ buf, cap ? cap - 1 : 0, 0 };
+	writeExpr(expr, out);
+
+	if(cap){
+		buf[out.len < out.cap ? out.len : out.cap] = '\0';
+	}
+
+	return out.len;
+}
+
+bool sexiExprWriteSink(SexiExprConst expr, SexiWriteFn fn, void *user){
+	return writeChunked(expr, [fn, user](const char *ptr, std::size_t n){
+		return fn(user, { .len = n, .ptr = ptr });
+	});
+}
+
+bool sexiExprWriteFd(SexiExprConst expr, int fd){
+#ifdef SEXI_WRITE_FD
+	return writeChunked(expr, [fd](const char *ptr, std::size_t n){
+		while(n){
+			auto written = SEXI_WRITE_FD(fd, ptr, n);
+			if(written < 0){
+				if(errno == EINTR) continue;
+				return false;
+			}
+
+			ptr += written;
+			n -= std::size_t(written);
+		}
+
+		return true;
+	});
+#else
+	(void)expr;
+	(void)fd;
+	return false;
+#endif
+}
@@ -0,0 +1,855 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sexi.h"
+#include "sexi/Tape.h"
+#include "sexi/Binary.h"
+
+#if __has_include(<unistd.h>) && __has_include(<sys/resource.h>)
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#define SEXI_BENCH_PEAK_RSS 1
+#endif
+
+#ifdef __GLIBC__
+extern "C" {
+	void *__libc_malloc(size_t);
+	void *__libc_calloc(size_t, size_t);
+	void *__libc_realloc(void*, size_t);
+	void __libc_free(void*);
+}
+
+static std::atomic<std::size_t> numAllocs = 0, numAllocBytes = 0;
+
+// interpose the C allocator so allocations made inside libsexi are counted too
+extern "C" {
+	void *malloc(size_t size){
+		numAllocs.fetch_add(1, std::memory_order_relaxed);
+		numAllocBytes.fetch_add(size, std::memory_order_relaxed);
+		return __libc_malloc(size);
+	}
+
+	void *calloc(size_t n, size_t size){
+		numAllocs.fetch_add(1, std::memory_order_relaxed);
+		numAllocBytes.fetch_add(n * size, std::memory_order_relaxed);
+		return __libc_calloc(n, size);
+	}
+
+	void *realloc(void *ptr, size_t size){
+		numAllocs.fetch_add(1, std::memory_order_relaxed);
+		numAllocBytes.fetch_add(size, std::memory_order_relaxed);
+		return __libc_realloc(ptr, size);
+	}
+
+	void free(void *ptr){ __libc_free(ptr); }
+}
+
+#define SEXI_BENCH_COUNT_ALLOCS 1
+#endif
+
+struct AllocStats{
+	std::size_t count = 0, bytes = 0;
+};
+
+static inline AllocStats allocStats(){
+#ifdef SEXI_BENCH_COUNT_ALLOCS
+	return { numAllocs.load(), numAllocBytes.load() };
+#else
+	return {};
+#endif
+}
+
+// config-like corpus: many small forms with ids, strings and numbers
+static std::string genConfigCorpus(std::size_t numForms){
+	std::string ret;
+	ret.reserve(numForms * 64);
+
+	for(std::size_t i = 0; i < numForms; i++){
+		ret += "(entry item";
+		ret += std::to_string(i);
+		ret += " (name \"value number ";
+		ret += std::to_string(i % 97);
+		ret += "\") (weight ";
+		ret += std::to_string(i % 1000);
+		ret += ".25) (tags alpha beta gamma))\n";
+	}
+
+	return ret;
+}
+
+// machine-generated corpus: few distinct forms, repeated type descriptors and operands
+static std::string genIrCorpus(std::size_t numForms){
+	std::string ret;
+	ret.reserve(numForms * 96);
+
+	for(std::size_t i = 0; i < numForms; i++){
+		auto reg = std::to_string(i % 64);
+
+		ret += "(set %";
+		ret += reg;
+		ret += " (call (fn ((ptr n32) (ptr n8)) (ptr n32)) (alloc n32) (load (ptr n32) %";
+		ret += std::to_string((i + 1) % 64);
+		ret += ")))\n";
+	}
+
+	return ret;
+}
+
+// one list with many elements
+static std::string genWideCorpus(std::size_t numElems){
+	std::string ret = "(row";
+	ret.reserve(numElems * 8);
+
+	for(std::size_t i = 0; i < numElems; i++){
+		ret += ' ';
+		ret += std::to_string(i);
+	}
+
+	ret += ")\n";
+	return ret;
+}
+
+// a single deeply nested list
+static std::string genDeepCorpus(std::size_t depth){
+	std::string ret;
+	ret.reserve(depth * 8);
+
+	for(std::size_t i = 0; i < depth; i++){
+		ret += "(node ";
+	}
+
+	ret += "leaf";
+	ret.append(depth, ')');
+	ret += '\n';
+	return ret;
+}
+
+// lists of eight tokens of a single kind, to time each token scanner on its own
+static std::string genTokenCorpus(std::size_t numLists, const char *token){
+	std::string ret;
+
+	for(std::size_t i = 0; i < numLists; i++){
+		ret += '(';
+		for(std::size_t j = 0; j < 8; j++){
+			if(j != 0) ret += ' ';
+			ret += token;
+		}
+		ret += ")\n";
+	}
+
+	return ret;
+}
+
+template<typename Fn>
+static void bench(const char *name, std::size_t srcLen, std::size_t iters, Fn &&fn){
+	auto allocsBefore = allocStats();
+	auto start = std::chrono::steady_clock::now();
+
+	for(std::size_t i = 0; i < iters; i++){
+		fn();
+	}
+
+	auto stop = std::chrono::steady_clock::now();
+	auto allocsAfter = allocStats();
+
+	auto secs = std::chrono::duration<double>(stop - start).count() / double(iters);
+	auto mbPerSec = (double(srcLen) / (1024.0 * 1024.0)) / secs;
+
+	std::printf(
+		"%-32s %10.3f ms %10.2f MB/s %12zu allocs %14zu bytes\n",
+		name, secs * 1000.0, mbPerSec,
+		(allocsAfter.count - allocsBefore.count) / iters,
+		(allocsAfter.bytes - allocsBefore.bytes) / iters
+	);
+}
+
+static void benchParse(const char *name, const std::string &src, std::size_t iters, bool copyStrs){
+	bench(name, src.size(), iters, [&]{
+		auto res = sexiParse(src.size(), src.data(), copyStrs);
+		if(sexiParseResultHasError(res)){
+			std::fprintf(stderr, "parse error in %s\n", name);
+			std::exit(EXIT_FAILURE);
+		}
+		sexiDestroyParseResult(res);
+	});
+}
+
+// parse once in a child process and report how far the parse pushed peak RSS
+static void benchPeakRss(const char *name, const std::string &src){
+#ifdef SEXI_BENCH_PEAK_RSS
+	std::fflush(stdout);
+
+	auto pid = fork();
+	if(pid == 0){
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		auto before = usage.ru_maxrss;
+
+		auto res = sexiParse(src.size(), src.data(), true);
+		auto failed = sexiParseResultHasError(res);
+
+		getrusage(RUSAGE_SELF, &usage);
+		auto after = usage.ru_maxrss;
+
+		sexiDestroyParseResult(res);
+
+		std::printf("%-32s %10ld KiB peak RSS growth\n", name, long(after - before));
+		std::fflush(stdout);
+		_exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+	else if(pid > 0){
+		int status = 0;
+		waitpid(pid, &status, 0);
+	}
+#else
+	(void)name;
+	(void)src;
+#endif
+}
+
+int main(int argc, char *argv[]){
+	std::size_t numForms = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+	if(numForms == 0) numForms = 1;
+
+	auto config = genConfigCorpus(numForms);
+
+	std::printf("corpus: %zu bytes\n", config.size());
+
+	benchParse("parse config (copy)", config, 5, true);
+	benchParse("parse config (zero-copy)", config, 5, false);
+
+	{
+		const char *path = "sexi-bench.se";
+
+		auto file = std::fopen(path, "wb");
+		if(file){
+			std::fwrite(config.data(), 1, config.size(), file);
+			std::fclose(file);
+
+			bench("parse config file (mmap)", config.size(), 5, [&]{
+				auto res = sexiParseFile(path, nullptr);
+				if(sexiParseResultHasError(res)){
+					std::fprintf(stderr, "parse error in %s\n", path);
+					std::exit(EXIT_FAILURE);
+				}
+				sexiDestroyParseResult(res);
+			});
+
+			std::remove(path);
+		}
+	}
+
+	for(std::size_t numThreads : { 2, 4, 8, 16, 32 }){
+		if(numThreads > std::thread::hardware_concurrency()) break;
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "parse config (%zu threads)", numThreads);
+
+		const SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = numThreads, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+		bench(name, config.size(), 5, [&]{
+			auto res = sexiParseEx(config.size(), config.data(), &opts);
+			if(sexiParseResultHasError(res)){
+				std::fprintf(stderr, "parse error in %s\n", name);
+				std::exit(EXIT_FAILURE);
+			}
+			sexiDestroyParseResult(res);
+		});
+	}
+
+	{
+		// a fresh table pays for every string once, a warm one only looks them up
+		bench("parse config (symbols)", config.size(), 5, [&]{
+			auto symbols = sexiCreateSymbolTable();
+			const SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = symbols, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+			auto res = sexiParseEx(config.size(), config.data(), &opts);
+			if(sexiParseResultHasError(res)){
+				std::fprintf(stderr, "symbol parse error\n");
+				std::exit(EXIT_FAILURE);
+			}
+
+			sexiDestroyParseResult(res);
+			sexiDestroySymbolTable(symbols);
+		});
+
+		auto symbols = sexiCreateSymbolTable();
+		const SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = symbols, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+		bench("parse config (warm symbols)", config.size(), 5, [&]{
+			auto res = sexiParseEx(config.size(), config.data(), &opts);
+			if(sexiParseResultHasError(res)){
+				std::fprintf(stderr, "symbol parse error\n");
+				std::exit(EXIT_FAILURE);
+			}
+
+			sexiDestroyParseResult(res);
+		});
+
+		std::printf("%-32s %10zu symbols\n", "config symbols", sexiSymbolTableSize(symbols));
+		sexiDestroySymbolTable(symbols);
+	}
+
+	{
+		// a region reused for every parse, freeing is a no-op and everything is dropped at once
+		struct Region{
+			std::vector<char> buf;
+			std::size_t used = 0;
+
+			void *alloc(std::size_t size){
+				auto off = (used + 15) & ~std::size_t(15);
+				if(off + 16 + size > buf.size()) return nullptr;
+
+				std::memcpy(buf.data() + off, &size, sizeof(size));
+				used = off + 16 + size;
+				return buf.data() + off + 16;
+			}
+		} region;
+
+		region.buf.resize(config.size() * 16);
+
+		const SexiAllocator regionAlloc = {
+			.alloc = [](void *self, size_t size){ return static_cast<Region*>(self)->alloc(size); },
+			.realloc = [](void *self, void *ptr, size_t size){
+				auto ret = static_cast<Region*>(self)->alloc(size);
+				if(ret && ptr){
+					std::size_t oldSize;
+					std::memcpy(&oldSize, static_cast<char*>(ptr) - 16, sizeof(oldSize));
+					std::memcpy(ret, ptr, oldSize < size ? oldSize : size);
+				}
+				return ret;
+			},
+			.free = [](void*, void*){},
+			.userdata = &region,
+		};
+
+		const SexiParseOptions opts = { .copyStrs = true, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = &regionAlloc, .locations = false, .recover = false, .lazyDepth = 0 };
+
+		bench("parse config (region allocator)", config.size(), 5, [&]{
+			region.used = 0;
+
+			auto res = sexiParseEx(config.size(), config.data(), &opts);
+			if(!res || sexiParseResultHasError(res)){
+				std::fprintf(stderr, "region parse error\n");
+				std::exit(EXIT_FAILURE);
+			}
+
+			sexiDestroyParseResult(res);
+		});
+	}
+
+	{
+		// spans cost a couple of bytes per expression, error positions nothing until a parse fails
+		const SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = true, .recover = false, .lazyDepth = 0 };
+
+		bench("parse config (locations)", config.size(), 5, [&]{
+			auto res = sexiParseEx(config.size(), config.data(), &opts);
+			if(sexiParseResultHasError(res)){
+				std::fprintf(stderr, "locations parse error\n");
+				std::exit(EXIT_FAILURE);
+			}
+			sexiDestroyParseResult(res);
+		});
+
+		auto res = sexiParseEx(config.size(), config.data(), &opts);
+		auto exprs = sexiParseResultExprs(res);
+		const auto numExprs = sexiParseResultNumExprs(res);
+
+		bench("locate config exprs", config.size(), 5, [&]{
+			for(std::size_t i = 0; i < numExprs; i++){
+				SexiSourceSpan span;
+				if(!sexiParseResultSpan(res, exprs[i], &span)){
+					std::fprintf(stderr, "missing span\n");
+					std::exit(EXIT_FAILURE);
+				}
+			}
+		});
+
+		sexiDestroyParseResult(res);
+
+		auto broken = config + "(broken 1.2.3)";
+		bench("parse config error position", broken.size(), 5, [&]{
+			auto res = sexiParse(broken.size(), broken.data(), false);
+			SexiSourcePos pos;
+			if(!sexiParseResultErrorPos(res, &pos)){
+				std::fprintf(stderr, "missing error position\n");
+				std::exit(EXIT_FAILURE);
+			}
+			sexiDestroyParseResult(res);
+		});
+	}
+
+	{
+		// one bad form in every thousand, a recovering parse keeps everything else in one pass
+		auto corrupt = config;
+		for(std::size_t pos = corrupt.size() / 1000; pos < corrupt.size(); pos += corrupt.size() / 1000){
+			auto formBeg = corrupt.rfind('(', pos);
+			if(formBeg != std::string::npos) corrupt[formBeg + 1] = '\x01';
+		}
+
+		const SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = true, .lazyDepth = 0 };
+
+		std::size_t numErrors = 0;
+		bench("parse corrupt config (recover)", corrupt.size(), 5, [&]{
+			auto res = sexiParseEx(corrupt.size(), corrupt.data(), &opts);
+			numErrors = sexiParseResultNumErrors(res);
+			sexiDestroyParseResult(res);
+		});
+
+		std::printf("%-32s %10zu errors\n", "corrupt config", numErrors);
+	}
+
+	{
+		// a dispatch loop only reads the head and first argument of each form, so nested lists are left unbuilt
+		for(std::size_t lazyDepth : { 0, 2 }){
+			const SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = lazyDepth };
+
+			std::size_t numHeads = 0;
+			bench(lazyDepth ? "dispatch config (lazy)" : "dispatch config (eager)", config.size(), 5, [&]{
+				auto res = sexiParseEx(config.size(), config.data(), &opts);
+				auto exprs = sexiParseResultExprs(res);
+				const auto numExprs = sexiParseResultNumExprs(res);
+
+				numHeads = 0;
+				for(std::size_t i = 0; i < numExprs; i++){
+					if(sexiExprIsId(sexiExprAt(exprs[i], 0)) && sexiExprIsId(sexiExprAt(exprs[i], 1))) ++numHeads;
+				}
+
+				sexiDestroyParseResult(res);
+			});
+
+			if(numHeads != numForms){
+				std::fprintf(stderr, "dispatch missed forms\n");
+				std::exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	{
+		// identical subtrees are built once, so the pool holds a tiny fraction of the nodes
+		const auto ir = genIrCorpus(numForms);
+		std::size_t numPooled = 0;
+
+		benchParse("parse ir", ir, 5, true);
+
+		bench("parse ir (pool)", ir.size(), 5, [&]{
+			auto pool = sexiCreateExprPool();
+			const SexiParseOptions opts = { .copyStrs = true, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = pool, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+			auto res = sexiParseEx(ir.size(), ir.data(), &opts);
+			if(sexiParseResultHasError(res)){
+				std::fprintf(stderr, "pool parse error\n");
+				std::exit(EXIT_FAILURE);
+			}
+
+			numPooled = sexiExprPoolSize(pool);
+
+			sexiDestroyParseResult(res);
+			sexiDestroyExprPool(pool);
+		});
+
+		std::printf("%-32s %10zu exprs\n", "ir pool size", numPooled);
+	}
+
+	{
+		const SexiParseOptions opts = { .copyStrs = true, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+		bench("parse config tape (copy)", config.size(), 5, [&]{
+			auto tape = sexiParseTape(config.size(), config.data(), &opts);
+			if(sexiTapeHasError(tape)){
+				std::fprintf(stderr, "tape parse error\n");
+				std::exit(EXIT_FAILURE);
+			}
+			sexiDestroyTape(tape);
+		});
+
+		// count numbers over the whole tree, chasing pointers vs one pass over the tape
+		auto res = sexiParse(config.size(), config.data(), true);
+		auto tape = sexiParseTape(config.size(), config.data(), &opts);
+
+		std::printf(
+			"%-32s %10zu entries %12zu bytes\n", "config tape footprint",
+			sexiTapeSize(tape), sexiTapeSize(tape) * sizeof(SexiTapeEntry) + config.size()
+		);
+
+		std::size_t treeNums = 0, tapeNums = 0;
+
+		bench("walk config tree", config.size(), 20, [&]{
+			std::vector<SexiExprConst> pending(sexiParseResultExprs(res), sexiParseResultExprs(res) + sexiParseResultNumExprs(res));
+			treeNums = 0;
+
+			while(!pending.empty()){
+				auto expr = pending.back();
+				pending.pop_back();
+
+				switch(sexiExprType(expr)){
+					case SEXI_NUM: ++treeNums; break;
+					case SEXI_LIST:
+						for(std::size_t i = 0; i < sexiExprLength(expr); i++){
+							pending.emplace_back(sexiExprAt(expr, i));
+						}
+						break;
+					default: break;
+				}
+			}
+		});
+
+		{
+			auto cppRes = sexi::parse(config);
+			std::size_t cppNums = 0;
+
+			struct NumCounter{
+				std::size_t &count;
+
+				void operator()(sexi::ExprRef expr) const{
+					if(expr.isNum()) ++count;
+					else if(expr.isList()) for(auto elem : expr) (*this)(elem);
+				}
+			};
+
+			bench("walk config tree (C++)", config.size(), 20, [&]{
+				cppNums = 0;
+				for(auto expr : cppRes) NumCounter{ cppNums }(expr);
+			});
+
+			if(cppNums == 0){
+				std::fprintf(stderr, "C++ walk found nothing\n");
+				std::exit(EXIT_FAILURE);
+			}
+
+			// the value decoded by the parse against converting the text on every use
+			struct NumSummer{
+				double &sum;
+				bool stored;
+
+				void operator()(sexi::ExprRef expr) const{
+					if(expr.isNum()){
+						double d = 0;
+						if(stored) expr.asDouble(d);
+						else d = std::strtod(std::string(expr.str()).c_str(), nullptr);
+						sum += d;
+					}
+					else if(expr.isList()) for(auto elem : expr) (*this)(elem);
+				}
+			};
+
+			double storedSum = 0, strtodSum = 0;
+
+			bench("sum config numbers (stored)", config.size(), 20, [&]{
+				storedSum = 0;
+				for(auto expr : cppRes) NumSummer{ storedSum, true }(expr);
+			});
+
+			bench("sum config numbers (strtod)", config.size(), 20, [&]{
+				strtodSum = 0;
+				for(auto expr : cppRes) NumSummer{ strtodSum, false }(expr);
+			});
+
+			if(storedSum != strtodSum){
+				std::fprintf(stderr, "number sums disagree\n");
+				std::exit(EXIT_FAILURE);
+			}
+		}
+
+		bench("walk config tape", config.size(), 20, [&]{
+			auto entries = sexiTapeEntries(tape);
+			auto n = sexiTapeSize(tape);
+			tapeNums = 0;
+
+			for(std::size_t i = 0; i < n; i++){
+				tapeNums += entries[i].type == SEXI_NUM;
+			}
+		});
+
+		if(treeNums != tapeNums){
+			std::fprintf(stderr, "tape and tree disagree\n");
+			std::exit(EXIT_FAILURE);
+		}
+
+		// loading a snapshot maps it and checks the entries, nothing is parsed
+		const char *snapshotPath = "sexi-bench.snapshot";
+		if(sexiTapeWriteSnapshot(tape, snapshotPath)){
+			bench("load config snapshot", config.size(), 20, [&]{
+				auto loaded = sexiTapeLoadSnapshot(snapshotPath);
+				if(sexiTapeHasError(loaded) || sexiTapeSize(loaded) != sexiTapeSize(tape)){
+					std::fprintf(stderr, "snapshot load error\n");
+					std::exit(EXIT_FAILURE);
+				}
+				sexiDestroyTape(loaded);
+			});
+
+			std::remove(snapshotPath);
+		}
+
+		sexiDestroyTape(tape);
+		sexiDestroyParseResult(res);
+	}
+
+	bench("scan config (events)", config.size(), 5, [&]{
+		std::size_t numTokens = 0;
+
+		auto countToken = [](void *user, SexiStr, size_t) -> bool{
+			++*static_cast<std::size_t*>(user);
+			return true;
+		};
+
+		const SexiParseEvents events = { .listBegin = nullptr, .listEnd = nullptr, .id = countToken, .str = countToken, .num = countToken };
+
+		auto err = sexiParseEvents(config.size(), config.data(), &events, &numTokens, nullptr);
+		if(err.len || !numTokens){
+			std::fprintf(stderr, "event parse error\n");
+			std::exit(EXIT_FAILURE);
+		}
+	});
+
+	bench("parse config stream (4KB chunks)", config.size(), 5, [&]{
+		std::size_t numExprs = 0;
+		auto parser = sexiParserCreate(nullptr, [](void *user, SexiExprConst){ ++*static_cast<std::size_t*>(user); }, &numExprs);
+
+		for(std::size_t i = 0; i < config.size(); i += 4096){
+			sexiParserFeed(parser, std::min<std::size_t>(4096, config.size() - i), config.data() + i);
+		}
+
+		if(!sexiParserFinish(parser) || numExprs != numForms){
+			std::fprintf(stderr, "stream parse error\n");
+			std::exit(EXIT_FAILURE);
+		}
+
+		sexiParserDestroy(parser);
+	});
+
+	{
+		auto res = sexiParse(config.size(), config.data(), false);
+		auto exprs = sexiParseResultExprs(res);
+		auto numExprs = sexiParseResultNumExprs(res);
+
+		std::string out;
+		out.reserve(config.size());
+
+		bench("write config (sink)", config.size(), 5, [&]{
+			out.clear();
+			for(std::size_t i = 0; i < numExprs; i++){
+				sexiExprWriteSink(exprs[i], [](void *user, SexiStr str){
+					static_cast<std::string*>(user)->append(str.ptr, str.len);
+					return true;
+				}, &out);
+			}
+		});
+
+		std::vector<char> buf(config.size() + 1);
+
+		bench("write config (buffer)", config.size(), 5, [&]{
+			std::size_t len = 0;
+			for(std::size_t i = 0; i < numExprs; i++){
+				len += sexiExprWrite(exprs[i], buf.data(), buf.size());
+			}
+
+			if(len == 0){
+				std::fprintf(stderr, "write produced nothing\n");
+				std::exit(EXIT_FAILURE);
+			}
+		});
+
+		sexiDestroyParseResult(res);
+	}
+
+	{
+		// two separate parses, so nothing is shared and every comparison looks at the whole tree
+		auto lhs = sexiParse(config.size(), config.data(), false);
+		auto rhs = sexiParse(config.size(), config.data(), false);
+		auto lhsExprs = sexiParseResultExprs(lhs), rhsExprs = sexiParseResultExprs(rhs);
+		auto numExprs = sexiParseResultNumExprs(lhs);
+
+		auto checkEqual = [](std::size_t numEqual, std::size_t expected){
+			if(numEqual != expected){
+				std::fprintf(stderr, "equal parses compared unequal\n");
+				std::exit(EXIT_FAILURE);
+			}
+		};
+
+		bench("equal config (sexiExprEqual)", config.size(), 5, [&]{
+			std::size_t numEqual = 0;
+			for(std::size_t i = 0; i < numExprs; i++){
+				numEqual += sexiExprEqual(lhsExprs[i], rhsExprs[i]);
+			}
+
+			checkEqual(numEqual, numExprs);
+		});
+
+		bench("equal config (toStr)", config.size(), 5, [&]{
+			std::size_t numEqual = 0;
+			std::string lhsStr, rhsStr;
+			for(std::size_t i = 0; i < numExprs; i++){
+				lhsStr.clear();
+				sexi::ExprRef(lhsExprs[i]).appendTo(lhsStr);
+
+				rhsStr.clear();
+				sexi::ExprRef(rhsExprs[i]).appendTo(rhsStr);
+				numEqual += lhsStr == rhsStr;
+			}
+
+			checkEqual(numEqual, numExprs);
+		});
+
+		std::uint64_t hashSum = 0;
+
+		bench("hash config (toStr)", config.size(), 5, [&]{
+			hashSum = 0;
+			std::string str;
+			for(std::size_t i = 0; i < numExprs; i++){
+				str.clear();
+				sexi::ExprRef(lhsExprs[i]).appendTo(str);
+				hashSum += std::hash<std::string>{}(str);
+			}
+		});
+
+		// the first pass fills the cache of every list, later ones only read the top
+		bench("hash config (first)", config.size(), 1, [&]{
+			hashSum = 0;
+			for(std::size_t i = 0; i < numExprs; i++){
+				hashSum += sexiExprHash(lhsExprs[i]);
+			}
+		});
+
+		bench("hash config (cached)", config.size(), 20, [&]{
+			hashSum = 0;
+			for(std::size_t i = 0; i < numExprs; i++){
+				hashSum += sexiExprHash(lhsExprs[i]);
+			}
+		});
+
+		if(!hashSum){
+			std::fprintf(stderr, "hashing produced nothing\n");
+			std::exit(EXIT_FAILURE);
+		}
+
+		sexiDestroyParseResult(lhs);
+		sexiDestroyParseResult(rhs);
+	}
+
+	{
+		auto res = sexiParse(config.size(), config.data(), false);
+		auto exprs = sexiParseResultExprs(res);
+		auto numExprs = sexiParseResultNumExprs(res);
+
+		std::string binary(sexiEncodeBinary(numExprs, exprs, nullptr, 0), '\0');
+
+		std::printf("%-32s %10zu bytes %12zu text bytes\n", "config binary size", binary.size(), config.size());
+
+		bench("encode config binary", config.size(), 5, [&]{
+			sexiEncodeBinary(numExprs, exprs, binary.data(), binary.size());
+		});
+
+		// throughput is relative to the text, so these compare directly with parsing it
+		for(bool copyStrs : { true, false }){
+			const SexiParseOptions opts = { .copyStrs = copyStrs, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+			bench(copyStrs ? "decode config binary (copy)" : "decode config binary (zero-copy)", config.size(), 5, [&]{
+				auto decoded = sexiDecodeBinary(binary.size(), binary.data(), &opts);
+				if(sexiParseResultHasError(decoded) || sexiParseResultNumExprs(decoded) != numExprs){
+					std::fprintf(stderr, "binary decode error\n");
+					std::exit(EXIT_FAILURE);
+				}
+				sexiDestroyParseResult(decoded);
+			});
+		}
+
+		sexiDestroyParseResult(res);
+	}
+
+	{
+		// telemetry-like values, built the way the C++ constructors used to and the way they do now
+		std::vector<double> values(numForms * 10);
+		for(std::size_t i = 0; i < values.size(); i++){
+			values[i] = double(i) * 0.37 + 1e-3;
+		}
+
+		std::size_t textLen = 0;
+		for(auto val : values){
+			auto expr = sexiCreateDouble(val);
+			textLen += sexiExprToStr(expr).len;
+			sexiDestroyExpr(expr);
+		}
+
+		bench("create numbers (to_string)", textLen, 5, [&]{
+			for(auto val : values){
+				auto str = std::to_string((long double)val);
+				auto expr = sexiCreateNum({ .len = str.size(), .ptr = str.data() });
+				sexiExprOwnString(expr);
+				sexiDestroyExpr(expr);
+			}
+		});
+
+		bench("create numbers (shortest)", textLen, 5, [&]{
+			for(auto val : values){
+				sexiDestroyExpr(sexiCreateDouble(val));
+			}
+		});
+	}
+
+	{
+		// appending in place scales linearly, copying the list for every element like `<<` used to doesn't
+		for(std::size_t numElems : { 25000, 50000, 100000 }){
+			const auto textLen = genWideCorpus(numElems).size();
+			char name[64];
+
+			std::snprintf(name, sizeof(name), "build %zuk list (<<)", numElems / 1000);
+			bench(name, textLen, 5, [&]{
+				auto row = sexi::Expr(sexi::id, "row");
+				for(std::size_t i = 0; i < numElems; i++){
+					row = std::move(row) << sexi::Expr(sexi::num, i);
+				}
+			});
+
+			std::snprintf(name, sizeof(name), "build %zuk list (builder)", numElems / 1000);
+			bench(name, textLen, 5, [&]{
+				sexi::ListBuilder row;
+				row << sexi::Expr(sexi::id, "row");
+				for(std::size_t i = 0; i < numElems; i++){
+					row << sexi::Expr(sexi::num, i);
+				}
+
+				auto list = row.build();
+			});
+		}
+
+		// quadratic, so only small sizes finish in reasonable time
+		for(std::size_t numElems : { 1000, 2000 }){
+			char name[64];
+			std::snprintf(name, sizeof(name), "build %zuk list (copying)", numElems / 1000);
+
+			bench(name, genWideCorpus(numElems).size(), 1, [&]{
+				auto row = sexi::Expr(sexi::list, std::vector<sexi::Expr>{ sexi::Expr(sexi::id, "row") });
+				for(std::size_t i = 0; i < numElems; i++){
+					auto elems = row.toList();
+					elems.emplace_back(sexi::num, i);
+					row = sexi::Expr(sexi::list, static_cast<const std::vector<sexi::Expr>&>(elems));
+				}
+			});
+		}
+	}
+
+	auto wide = genWideCorpus(numForms * 10);
+	auto deep = genDeepCorpus(5000);
+
+	benchParse("parse wide", wide, 5, true);
+	benchParse("parse deep", deep, 5, true);
+
+	benchParse("parse ids", genTokenCorpus(numForms, "alpha-beta_gamma12"), 5, false);
+	benchParse("parse numbers", genTokenCorpus(numForms, "1234567.8901"), 5, false);
+	benchParse("parse strings", genTokenCorpus(numForms, "\"some quoted \\\"text\\\" here\""), 5, false);
+
+	benchPeakRss("peak rss config", config);
+	benchPeakRss("peak rss wide", wide);
+	benchPeakRss("peak rss deep", deep);
+
+	return 0;
+}
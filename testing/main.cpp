@@ -1,14 +1,33 @@
 #include <cassert>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <random>
 #include <sstream>
+#include <thread>
+
+#if __has_include(<sys/stat.h>) && __has_include(<unistd.h>)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "sexi.h"
+#include "sexi/Tape.h"
+#include "sexi/Binary.h"
 #include "sexi/literals.hpp"
 
+#include "scan.hpp"
+
 using namespace sexi;
 using namespace sexi::literals;
 
@@ -23,13 +42,13 @@ static inline void expect(T &&value, U &&expected){
 
 // empty expression:
 // ()
-void testEmpty(const sexi::Expr &v){
+void testEmpty(sexi::ExprRef v){
 	assert(v.isEmpty());
 }
 
 // array expression:
 // (1 2 3 4)
-void testArray(const sexi::Expr &v){
+void testArray(sexi::ExprRef v){
 	assert(v.isList());
 	assert(v.length() == 4);
 	assert(v[0].toStr() == "1");
@@ -40,11 +59,11 @@ void testArray(const sexi::Expr &v){
 
 // list expression:
 // (1 (2 (3 (4 ()))))
-void testList(const sexi::Expr &v){
+void testList(sexi::ExprRef v){
 	std::vector<std::string> parsedElements;
 	parsedElements.reserve(4);
 
-	sexi::Expr element = v;
+	sexi::ExprRef element = v;
 
 	while(1){
 		assert(element.isList());
@@ -69,7 +88,7 @@ void testList(const sexi::Expr &v){
 
 // text expression:
 // (bold italic "Hello")
-void testText(const sexi::Expr &v){
+void testText(sexi::ExprRef v){
 	assert(v.isList());
 	assert(v.length() == 3);
 	assert(v[0].isId());
@@ -82,7 +101,7 @@ void testText(const sexi::Expr &v){
 
 // math expression:
 // (+ (/ 1.3 2.6) (* 0.0162 569.27))
-void testMath(const sexi::Expr &v){
+void testMath(sexi::ExprRef v){
 	assert(v.isList());
 	assert(v.length() == 3);
 	assert(v[0].isId());
@@ -115,7 +134,7 @@ void testMath(const sexi::Expr &v){
 
 // set expression:
 // (= %0 (alloc n32))
-void testSet(const sexi::Expr &v){
+void testSet(sexi::ExprRef v){
 	assert(v.isList());
 	assert(v.length() == 3);
 	assert(v[0].isId());
@@ -166,6 +185,1648 @@ void testOperators(){
 	testSet(setExpr);
 }
 
+// rvalue appends reuse the list they append to instead of cloning it
+void testListBuilder(){
+	sexi::ListBuilder builder;
+	for(int i = 0; i < 1000; i++) builder << i;
+
+	expect(builder.size(), 1000u);
+
+	auto built = builder.build();
+	expect(builder.size(), 0u);
+	expect(built.length(), 1000u);
+	expect(built[999].str(), "999");
+
+	std::string expected = "(row 0";
+	auto row = "row"_se << 0;
+	auto rowPtr = SexiExprConst(row);
+
+	for(int i = 1; i < 100; i++){
+		row = std::move(row) << i;
+		expected += " " + std::to_string(i);
+	}
+
+	expect(SexiExprConst(row), rowPtr);
+	expect(row.toStr(), expected + ")");
+
+	// lvalues are left alone
+	auto longer = row << "tail";
+	expect(row.length(), 101u);
+	expect(longer.length(), 102u);
+	expect((""_se << 1).toStr(), "(() 1)");
+
+	// hashes of lists built by hand follow them as they grow
+	auto hashBefore = sexiExprHash(row);
+	row = std::move(row) << "tail";
+	expect(sexiExprHash(row) == hashBefore, false);
+	expect(sexiExprHash(row), sexiExprHash(longer));
+
+	// even when the list that grows is nested in the one hashed
+	auto inner = sexiCreateListEx(0, nullptr, nullptr);
+	auto outer = sexiCreateEmpty();
+	assert(sexiExprAppend(outer, inner));
+
+	auto parsedOuter = sexi::parse("((1))");
+	auto emptyOuter = sexi::parse("(())");
+	expect(sexiExprHash(outer), sexiExprHash(emptyOuter[0]));
+	assert(sexiExprEqual(outer, emptyOuter[0]));
+
+	assert(sexiExprAppend(inner, sexiCreateInt(1)));
+	expect(sexiExprHash(outer), sexiExprHash(parsedOuter[0]));
+	assert(sexiExprEqual(outer, parsedOuter[0]));
+	assert(!sexiExprEqual(outer, emptyOuter[0]));
+	sexiDestroyExpr(outer);
+
+	std::vector<sexi::Expr> elems;
+	std::vector<SexiExprConst> elemPtrs;
+	for(int i = 0; i < 10; i++){
+		elems.emplace_back(sexi::num, i);
+		elemPtrs.emplace_back(elems.back());
+	}
+
+	sexi::Expr moved(sexi::list, std::move(elems));
+	expect(elems.empty(), true);
+	expect(moved.length(), 10u);
+	for(std::size_t i = 0; i < elemPtrs.size(); i++){
+		expect(SexiExprConst(moved[i]), elemPtrs[i]);
+	}
+
+	// lists created whole have no spare room, the first append must grow them
+	auto whole = sexi::Expr(sexi::list, 3, elemPtrs.data());
+	for(int i = 0; i < 20; i++) whole = std::move(whole) << i;
+	expect(whole.length(), 23u);
+	expect(whole[22].str(), "19");
+
+	// only lists and empty expressions can be appended to
+	auto id = sexiCreateId({ .len = 3, .ptr = "add" });
+	auto elem = sexiCreateInt(1);
+	assert(!sexiExprAppend(id, elem));
+	assert(sexiExprIsId(id));
+	expect(std::string_view(sexiExprToStr(id).ptr), "add");
+	sexiDestroyExpr(id);
+
+	// nor can parsed ones, which don't know the allocator of the heap ones
+	std::string text = "(a b)";
+	auto parsed = sexiParse(text.size(), text.data(), false);
+	auto parsedList = const_cast<SexiExpr>(sexiParseResultExprs(parsed)[0]);
+	auto parsedId = const_cast<SexiExpr>(sexiExprAt(parsedList, 0));
+
+	assert(!sexiExprAppend(parsedList, elem));
+	expect(sexiExprLength(parsedList), 2u);
+
+	sexiExprOwnString(parsedId);
+	expect(sexiExprToStr(parsedId).ptr, text.data() + 1);
+
+	sexiDestroyParseResult(parsed);
+	sexiDestroyExpr(elem);
+}
+
+// zero-copy parsing must reference the source for nested elements too
+void testZeroCopy(std::string_view src){
+	auto res = sexiParse(src.size(), src.data(), false);
+	assert(!sexiParseResultHasError(res));
+
+	auto inSrc = [src](SexiStr str){
+		return str.ptr >= src.data() && (str.ptr + str.len) <= (src.data() + src.size());
+	};
+
+	auto exprs = sexiParseResultExprs(res);
+
+	for(size_t i = 0; i < sexiParseResultNumExprs(res); i++){
+		auto body = sexiExprAt(exprs[i], 1);
+		for(size_t j = 0; j < sexiExprLength(body); j++){
+			auto elem = sexiExprAt(body, j);
+			if(sexiExprIsId(elem) || sexiExprIsStr(elem)){
+				assert(inSrc(sexiExprToStr(elem)));
+			}
+		}
+	}
+
+	sexiDestroyParseResult(res);
+}
+
+// nesting is bounded by SexiParseOptions::maxDepth, not by the call stack
+void testDepthLimit(){
+	std::string_view nested = "(a (b (c)))";
+
+	SexiParseOptions opts = { .copyStrs = true, .maxDepth = 2, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+	auto tooDeep = sexi::parse(nested, opts);
+	assert(tooDeep.hasError());
+	expect(tooDeep.error(), "maximum nesting depth exceeded");
+
+	opts.maxDepth = 3;
+
+	auto justRight = sexi::parse(nested, opts);
+	assert(!justRight.hasError());
+	assert(justRight.size() == 1);
+
+	std::size_t depth = 1000000;
+
+	std::string deep(depth, '(');
+	deep.append(depth, ')');
+
+	// C API directly, the C++ wrapper clones results recursively
+	auto deepResult = sexiParse(deep.size(), deep.data(), true);
+	assert(!sexiParseResultHasError(deepResult));
+	assert(sexiParseResultNumExprs(deepResult) == 1);
+	sexiDestroyParseResult(deepResult);
+}
+
+// every vector kernel must classify exactly like the portable one, which is otherwise never run on x86
+void testScanKernels(){
+	std::size_t numKernels;
+	auto kernels = sexi::detail::classifyKernels(numKernels);
+	expect(std::string_view(kernels[0].name), "scalar");
+	expect(std::string_view(kernels[numKernels - 1].name), sexi::detail::classifyKernelName());
+
+	// structural bytes, every kind of whitespace and the bytes just outside of '\t'..'\r'
+	constexpr std::string_view alphabet = "()\"\\ \t\n\v\f\rab1.\x08\x0e\x7f\x80\xff";
+
+	std::mt19937_64 rng(0x5e41);
+	std::string src;
+
+	while(src.size() < 64 * 512){
+		// long runs of backslashes carry their parity into the next block
+		if(rng() % 16 == 0){
+			src.append(1 + rng() % 130, '\\');
+		}
+		else{
+			src += alphabet[rng() % alphabet.size()];
+		}
+	}
+
+	src.resize(64 * 512);
+
+	auto scanAll = [&](const sexi::detail::ClassifyKernel &kernel){
+		std::vector<std::uint64_t> ret;
+		sexi::detail::ScanState state;
+
+		for(std::size_t off = 0; off < src.size(); off += 64){
+			auto masks = kernel.classify(src.data() + off);
+			ret.insert(ret.end(), { masks.open, masks.close, masks.quote, masks.backslash, masks.ws });
+			ret.push_back(sexi::detail::scanMasks(masks, state));
+		}
+
+		ret.insert(ret.end(), { state.prevEscaped, state.prevInStr, state.prevTokChar });
+		return ret;
+	};
+
+	auto expected = scanAll(kernels[0]);
+
+	for(std::size_t i = 1; i < numKernels; i++){
+		assert(scanAll(kernels[i]) == expected);
+
+		for(std::size_t len = 0; len < 200; len += 7){
+			auto beg = src.data() + len, end = src.data() + src.size() - len;
+			expect(kernels[i].countNewlines(beg, end), kernels[0].countNewlines(beg, end));
+		}
+	}
+}
+
+// strings, escapes and tokens that straddle the scanner's 64 byte blocks
+void testBlockBoundaries(){
+	for(std::size_t pad = 0; pad < 70; pad++){
+		std::string longStr = "\"" + std::string(pad, 'x') + "\\\" (not a list) \\\\\"";
+		std::string longId = std::string(pad + 1, 'y');
+
+		std::string src = std::string(pad, ' ') + "(" + longId + " " + longStr + " 12.50)";
+
+		auto result = sexi::parse(src);
+		assert(!result.hasError());
+		assert(result.size() == 1);
+
+		auto &&expr = result.exprs()[0];
+		assert(expr.length() == 3);
+		assert(expr[0].isId());
+		expect(expr[0].toStr(), longId);
+		assert(expr[1].isStr());
+		expect(expr[1].toStr(), longStr);
+		assert(expr[2].isNum());
+		expect(expr[2].toStr(), "12.5");
+	}
+
+	auto unterminated = sexi::parse("(a \"b\\\")");
+	assert(unterminated.hasError());
+	expect(unterminated.error(), "unexpected end of source in string");
+
+	auto topLevel = sexi::parse("(a) b");
+	assert(topLevel.hasError());
+	expect(topLevel.error(), "unexpected token at top level");
+}
+
+// character classes must not depend on the global C locale
+void testLocale(){
+	std::string_view src = "(caf\xe9 1.5 \"d\xe9j\xe0\")";
+
+	auto checkResult = [src]{
+		auto result = sexi::parse(src);
+		assert(result.hasError());
+		expect(result.error(), "unexpected character in identifier");
+
+		auto valid = sexi::parse("(cafe 1.5 \"d\xe9j\xe0\")");
+		assert(!valid.hasError());
+		assert(valid.exprs()[0].length() == 3);
+	};
+
+	checkResult();
+
+	for(auto name : { "C.UTF-8", "en_US.ISO-8859-1", "de_DE.ISO-8859-1" }){
+		if(std::setlocale(LC_ALL, name)){
+			checkResult();
+		}
+	}
+
+	std::setlocale(LC_ALL, "C");
+}
+
+// parsing straight from a mapped file matches parsing the same text from memory
+void testParseFile(std::string_view src){
+	auto fromFile = sexi::parseFile("test.se");
+	auto fromStr = sexi::parse(src);
+
+	assert(!fromFile.hasError());
+	assert(fromFile.size() == fromStr.size());
+
+	for(std::size_t i = 0; i < fromFile.size(); i++){
+		expect(fromFile.exprs()[i].toStr(), fromStr.exprs()[i].toStr());
+	}
+
+	auto missing = sexi::parseFile("does-not-exist.se");
+	assert(missing.hasError());
+	expect(missing.error(), "failed to open file");
+
+#if __has_include(<sys/stat.h>) && __has_include(<unistd.h>)
+	// pipes have no size up front, so they're read to the end
+	auto fifo = (std::filesystem::temp_directory_path() / ("sexi-test-" + std::to_string(getpid()) + ".fifo")).string();
+	assert(mkfifo(fifo.c_str(), 0600) == 0);
+
+	std::thread writer([&]{ std::ofstream(fifo, std::ios::binary) << src; });
+	auto fromFifo = sexi::parseFile(fifo.c_str());
+	writer.join();
+	std::filesystem::remove(fifo);
+
+	assert(!fromFifo.hasError());
+	expect(fromFifo.size(), fromStr.size());
+	expect(fromFifo[fromFifo.size() - 1].toStr(), fromStr[fromStr.size() - 1].toStr());
+#endif
+}
+
+// feeding in chunks of any size must give the same expressions as parsing in one go
+void testStreaming(std::string_view src){
+	auto whole = sexi::parse(src);
+
+	for(std::size_t chunkSize : { 1, 3, 64, 100, 4096 }){
+		std::vector<std::string> strs;
+
+		sexi::Parser parser([&](sexi::ExprRef expr){ strs.emplace_back(expr.toStr()); });
+
+		for(std::size_t i = 0; i < src.size(); i += chunkSize){
+			assert(parser.feed(src.substr(i, chunkSize)));
+		}
+
+		assert(parser.finish());
+		assert(strs.size() == whole.size());
+
+		for(std::size_t i = 0; i < strs.size(); i++){
+			expect(strs[i], whole.exprs()[i].toStr());
+		}
+	}
+
+	// expressions are emitted as soon as they close
+	std::size_t numEmitted = 0;
+	sexi::Parser parser([&](sexi::ExprRef){ ++numEmitted; });
+
+	assert(parser.feed("(a \"b\\"));
+	assert(parser.feed("\" c\" 1"));
+	expect(numEmitted, 0u);
+	assert(parser.feed("23)(d"));
+	expect(numEmitted, 1u);
+	assert(!parser.finish());
+	expect(parser.error(), "unexpected end of source in id");
+
+	sexi::Parser topLevel([](sexi::ExprRef){});
+	assert(topLevel.feed("(a) "));
+	assert(!topLevel.feed("b"));
+	expect(topLevel.error(), "unexpected token at top level");
+}
+
+// rebuilds the text of the source from events, which must match the tree's
+struct EventPrinter{
+	explicit EventPrinter(std::string_view src): src(src){}
+
+	std::string_view src;
+	std::string out;
+	std::size_t depth = 0, numTokens = 0;
+
+	void sep(){ if(!out.empty() && out.back() != '(' && depth) out += ' '; }
+
+	bool listBegin(std::size_t offset){
+		assert(src[offset] == '(');
+		sep();
+		out += '(';
+		++depth;
+		return true;
+	}
+
+	bool listEnd(std::size_t offset){
+		assert(src[offset] == ')');
+		out += ')';
+		if(--depth == 0) out += '\n';
+		return true;
+	}
+
+	bool token(std::string_view tok, std::size_t offset){
+		expect(src.substr(offset, tok.size()), tok);
+		sep();
+		out += tok;
+		++numTokens;
+		return numTokens != 1000;
+	}
+
+	bool id(std::string_view tok, std::size_t offset){ return token(tok, offset); }
+	bool str(std::string_view tok, std::size_t offset){ return token(tok, offset); }
+	bool num(std::string_view tok, std::size_t offset){ return token(tok, offset); }
+};
+
+void testEvents(std::string_view src){
+	auto result = sexi::parse(src);
+
+	std::string expected;
+	for(auto &&expr : result){
+		expected += expr.toStr();
+		expected += '\n';
+	}
+
+	EventPrinter printer(src);
+	expect(sexi::parseEvents(src, printer), "");
+	expect(printer.depth, 0u);
+
+	// numbers in the test file are already in the form the tree prints them in
+	expect(printer.out, expected);
+
+	// a handler can stop early
+	std::string many;
+	for(int i = 0; i < 2000; i++) many += "(a)";
+
+	EventPrinter stopper(many);
+	expect(sexi::parseEvents(many, stopper), "parsing stopped by event handler");
+	expect(stopper.numTokens, 1000u);
+
+	// errors are reported after the events before them
+	EventPrinter partial("(a b) (c");
+	expect(sexi::parseEvents(partial.src, partial), "unexpected end of source in id");
+	expect(partial.numTokens, 2u);
+}
+
+// splitting between threads must never cut through a string, whatever parens it holds
+void testParallel(){
+	std::string src;
+	for(int i = 0; src.size() < 4 * 1024 * 1024; i++){
+		src += "(form " + std::to_string(i) + " \")(\\\\\" \"(\\\")\" (nested (list \"" + std::string(i % 100, ')') + "\") " + std::to_string(i * 0.5) + "))\n";
+	}
+
+	SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = 1, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+	auto serial = sexiParseEx(src.size(), src.data(), &opts);
+	assert(!sexiParseResultHasError(serial));
+
+	opts.numThreads = 8;
+
+	auto parallel = sexiParseEx(src.size(), src.data(), &opts);
+	assert(!sexiParseResultHasError(parallel));
+
+	auto numExprs = sexiParseResultNumExprs(serial);
+	expect(sexiParseResultNumExprs(parallel), numExprs);
+
+	auto serialExprs = sexiParseResultExprs(serial);
+	auto parallelExprs = sexiParseResultExprs(parallel);
+
+	for(std::size_t i = 0; i < numExprs; i++){
+		expect(sexi::ExprRef(parallelExprs[i]).toStr(), sexi::ExprRef(serialExprs[i]).toStr());
+	}
+
+	// parses on several threads at once share the worker threads
+	std::vector<std::thread> callers;
+	std::vector<std::size_t> callerExprs(4);
+
+	for(std::size_t t = 0; t < callerExprs.size(); t++){
+		callers.emplace_back([&, t]{
+			auto res = sexiParseEx(src.size(), src.data(), &opts);
+			if(!sexiParseResultHasError(res)) callerExprs[t] = sexiParseResultNumExprs(res);
+			sexiDestroyParseResult(res);
+		});
+	}
+
+	for(auto &caller : callers) caller.join();
+	for(auto count : callerExprs) expect(count, numExprs);
+
+	sexiDestroyParseResult(parallel);
+	sexiDestroyParseResult(serial);
+
+	// the first error in the source wins, with the expressions before it kept
+	src.insert(src.size() * 3 / 4, "stray ");
+	src.insert(src.size() / 2, "(unclosed \"");
+
+	opts.numThreads = 1;
+	serial = sexiParseEx(src.size(), src.data(), &opts);
+
+	opts.numThreads = 8;
+	parallel = sexiParseEx(src.size(), src.data(), &opts);
+
+	assert(sexiParseResultHasError(serial) && sexiParseResultHasError(parallel));
+
+	auto serialErr = sexiParseResultError(serial), parallelErr = sexiParseResultError(parallel);
+	expect(std::string_view(parallelErr.ptr, parallelErr.len), std::string_view(serialErr.ptr, serialErr.len));
+	expect(sexiParseResultNumExprs(parallel), sexiParseResultNumExprs(serial));
+
+	sexiDestroyParseResult(parallel);
+	sexiDestroyParseResult(serial);
+}
+
+// walk a tape and a tree side by side, they must hold the same expressions
+static void expectSameTree(sexi::TapeExpr tapeExpr, SexiExprConst expr){
+	expect(tapeExpr.type(), sexiExprType(expr));
+	expect(tapeExpr.length(), sexiExprLength(expr));
+
+	if(tapeExpr.isList()){
+		std::size_t i = 0;
+		for(auto elem : tapeExpr){
+			expectSameTree(elem, sexiExprAt(expr, i));
+			expectSameTree(tapeExpr[i], sexiExprAt(expr, i));
+			++i;
+		}
+
+		expect(i, tapeExpr.length());
+	}
+	else{
+		auto str = sexiExprToStr(expr);
+		expect(tapeExpr.str(), std::string_view(str.ptr, str.len));
+	}
+}
+
+void testTape(std::string_view src){
+	auto tree = sexi::parse(src);
+
+	for(bool copyStrs : { true, false }){
+		const SexiParseOptions opts = { .copyStrs = copyStrs, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+		auto tape = sexi::parseTape(src, &opts);
+		assert(!tape.hasError());
+		expect(tape.size(), tree.size());
+
+		std::size_t i = 0;
+		for(auto expr : tape){
+			expectSameTree(expr, tree.exprs()[i++]);
+		}
+
+		expect(i, tree.size());
+	}
+
+	// only complete top-level expressions are kept on error
+	auto bad = sexi::parseTape("(a (b)) (c () 1.50) (d (e");
+	assert(bad.hasError());
+	expect(bad.error(), "unexpected end of source in id");
+	expect(bad.size(), 2u);
+	expect(bad.numEntries(), 8u);
+
+	auto second = *++bad.begin();
+	expect(second[1].isEmpty(), true);
+	expect(second[1].str(), "()");
+	expect(second[2].str(), "1.5");
+}
+
+// snapshots load back into the same tape without parsing, and anything malformed is rejected
+void testSnapshot(std::string_view src){
+	auto tree = sexi::parse(src);
+	const char *path = "sexi-test-snapshot.bin";
+
+	for(bool copyStrs : { true, false }){
+		const SexiParseOptions opts = { .copyStrs = copyStrs, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+		auto tape = sexi::parseTape(src, &opts);
+		assert(tape.writeSnapshot(path));
+
+		auto loaded = sexi::loadTapeSnapshot(path);
+		assert(!loaded.hasError());
+		expect(loaded.size(), tree.size());
+		expect(loaded.numEntries(), tape.numEntries());
+
+		std::size_t i = 0;
+		for(auto expr : loaded){
+			expectSameTree(expr, tree.exprs()[i++]);
+		}
+	}
+
+	std::remove(path);
+
+	auto tape = sexi::parseTape("(a (b \"c\") () 1.5) (d)");
+	auto size = sexiTapeSnapshot(tape.handle(), nullptr, 0);
+
+	std::vector<std::uint64_t> storage((size + 7) / 8);
+	auto data = reinterpret_cast<char*>(storage.data());
+	expect(sexiTapeSnapshot(tape.handle(), data, size), size);
+
+	auto fromMemory = sexiTapeFromSnapshot(size, data);
+	assert(!sexiTapeHasError(fromMemory));
+	expect(sexiTapeNumExprs(fromMemory), 2u);
+	expect(sexiTapeStr(fromMemory, sexiTapeAt(fromMemory, 0, 1) + 2).len, 3u);
+	sexiDestroyTape(fromMemory);
+
+	auto expectInvalid = [&](std::size_t len, std::string_view err){
+		auto invalid = sexiTapeFromSnapshot(len, data);
+		assert(sexiTapeHasError(invalid));
+
+		auto str = sexiTapeError(invalid);
+		expect(std::string_view(str.ptr, str.len), err);
+
+		sexiDestroyTape(invalid);
+	};
+
+	expectInvalid(size - 1, "snapshot sections out of bounds");
+	expectInvalid(32, "snapshot too small");
+
+	// the first entry of the tape follows the 64 byte header
+	auto entries = reinterpret_cast<SexiTapeEntry*>(data + 64);
+
+	++entries[0].len;
+	expectInvalid(size, "list length mismatch in snapshot");
+	--entries[0].len;
+
+	entries[0].skip += 3;
+	expectInvalid(size, "invalid list in snapshot");
+	entries[0].skip -= 3;
+
+	entries[1].off = 1000;
+	expectInvalid(size, "string out of bounds in snapshot");
+	entries[1].off = 0;
+
+	data[0] = 'X';
+	expectInvalid(size, "invalid snapshot header");
+}
+
+// numbers carry their value from parsing, conversions only check the range
+void testNumbers(){
+	const std::string tiny = "0." + std::string(400, '0') + "1";
+
+	auto result = sexi::parse(
+		"(0 42 007 9223372036854775807 9223372036854775808 18446744073709551616"
+		" 1.50 2.0 1e3 1e400 " + tiny + " 12abc x)"
+	);
+	assert(!result.hasError());
+
+	auto nums = result[0];
+
+	std::int64_t i = -1;
+	std::uint64_t u = 0;
+	double d = 0;
+
+	expect(nums[0].asInt(i), SEXI_NUM_OK);
+	expect(i, 0);
+
+	expect(nums[1].asInt(i), SEXI_NUM_OK);
+	expect(i, 42);
+
+	expect(nums[2].asInt(i), SEXI_NUM_OK);
+	expect(i, 7);
+	expect(nums[2].str(), "007");
+
+	expect(nums[3].asInt(i), SEXI_NUM_OK);
+	expect(i, INT64_MAX);
+
+	expect(nums[4].asInt(i), SEXI_NUM_OUT_OF_RANGE);
+	expect(i, INT64_MAX);
+	expect(nums[4].asUint(u), SEXI_NUM_OK);
+	expect(u, std::uint64_t(INT64_MAX) + 1);
+
+	expect(nums[5].asUint(u), SEXI_NUM_OUT_OF_RANGE);
+	expect(u, UINT64_MAX);
+	expect(nums[5].asDouble(d), SEXI_NUM_OK);
+	expect(d, 18446744073709551616.0);
+
+	expect(nums[6].str(), "1.5");
+	expect(nums[6].asDouble(d), SEXI_NUM_OK);
+	expect(d, 1.5);
+	expect(nums[6].asInt(i), SEXI_NUM_NOT_INTEGER);
+	expect(i, 1);
+
+	expect(nums[7].asInt(i), SEXI_NUM_OK);
+	expect(i, 2);
+
+	expect(nums[8].asInt(i), SEXI_NUM_OK);
+	expect(i, 1000);
+
+	expect(nums[9].asDouble(d), SEXI_NUM_OUT_OF_RANGE);
+	assert(std::isinf(d));
+
+	expect(nums[10].asDouble(d), SEXI_NUM_OUT_OF_RANGE);
+	expect(d, 0.0);
+
+	d = -1;
+	expect(nums[11].asDouble(d), SEXI_NUM_INVALID);
+	expect(nums[12].asDouble(d), SEXI_NUM_INVALID);
+	expect(d, -1.0);
+
+	// expressions made by hand and their copies are decoded too
+	sexi::Expr made(sexi::num, "12.250");
+	expect(made.str(), "12.25");
+	expect(made.asDouble(d), SEXI_NUM_OK);
+	expect(d, 12.25);
+
+	sexi::Expr copy = made;
+	expect(copy.asDouble(d), SEXI_NUM_OK);
+	expect(d, 12.25);
+
+	// zeros ending an exponent are part of it, not of the fraction
+	auto expResult = sexi::parse("(1.5e10 2.50E20 1.0e0)");
+	assert(!expResult.hasError());
+	auto exps = expResult[0];
+
+	expect(exps[0].str(), "1.5e10");
+	expect(exps[0].asDouble(d), SEXI_NUM_OK);
+	expect(d, 1.5e10);
+	expect(exps[0].asInt(i), SEXI_NUM_OK);
+	expect(i, 15000000000);
+
+	expect(exps[1].str(), "2.50E20");
+	expect(exps[1].asDouble(d), SEXI_NUM_OK);
+	expect(d, 2.5e20);
+
+	expect(exps[2].asDouble(d), SEXI_NUM_OK);
+	expect(d, 1.0);
+
+	sexi::Expr madeExp(sexi::num, "3.10e-10");
+	expect(madeExp.str(), "3.10e-10");
+	expect(madeExp.asDouble(d), SEXI_NUM_OK);
+	expect(d, 3.1e-10);
+
+	// leading zeros don't push a small integer out of range
+	auto paddedResult = sexi::parse("(00000000000000000001 0000000000000000000009223372036854775807 000000000000000000000.5)");
+	assert(!paddedResult.hasError());
+	auto padded = paddedResult[0];
+
+	expect(padded[0].asInt(i), SEXI_NUM_OK);
+	expect(i, 1);
+	expect(padded[1].asInt(i), SEXI_NUM_OK);
+	expect(i, INT64_MAX);
+	expect(padded[2].asDouble(d), SEXI_NUM_OK);
+	expect(d, 0.5);
+}
+
+// numbers made from values print the shortest text that parses back to the same value
+void testNumberFormat(){
+	expect(sexi::Expr(num, 1.3).str(), "1.3");
+	expect((1.3_se).str(), "1.3");
+	expect(sexi::Expr(num, 1e-9).str(), "0.000000001");
+	expect(sexi::Expr(num, 0.1 + 0.2).str(), "0.30000000000000004");
+	expect(sexi::Expr(num, 2.0).str(), "2");
+	expect(sexi::Expr(num, 1e300).str(), "1e+300");
+	expect(sexi::Expr(num, -5).str(), "-5");
+	expect(sexi::Expr(num, UINT64_MAX).str(), "18446744073709551615");
+	expect((42_se).str(), "42");
+
+	std::int64_t i = 0;
+	expect(sexi::Expr(num, -5).asInt(i), SEXI_NUM_OK);
+	expect(i, -5);
+
+	double d = 0;
+	expect(sexi::Expr(num, 1e-9).asDouble(d), SEXI_NUM_OK);
+	expect(d, 1e-9);
+
+	// exponents can't be read back, but anything short enough to write without one can
+	for(double val : { 1.3, 1e-9, 123456.789, 0.1 + 0.2, 6.02214076e23, 1.5e-20 }){
+		auto text = sexi::Expr(num, val).toStr();
+		auto parsed = sexi::parse("(" + text + ")");
+		assert(!parsed.hasError());
+
+		expect(parsed[0][0].asDouble(d), SEXI_NUM_OK);
+		expect(d, val);
+	}
+}
+
+// interned ids share one string per symbol, within a parse and across parses
+void testSymbols(std::string_view src){
+	sexi::SymbolTable symbols;
+	expect(symbols.intern("add"), 0u);
+
+	const SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = symbols.handle(), .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+	std::string text = "(add 1 (sub x \"add\") add) (x)";
+	auto first = sexi::parse(text, opts);
+	auto second = sexi::parse("(sub add y)", opts);
+
+	expect(first[0][0].symbol(), 0u);
+	expect(first[0][3].symbol(), 0u);
+	expect(second[0][1].symbol(), 0u);
+	expect(first[0][2][0].symbol(), second[0][0].symbol());
+	expect(first[0][2][1].symbol(), first[1][0].symbol());
+
+	expect(first[0][1].symbol(), SEXI_NO_SYMBOL);
+	expect(first[0][2][2].symbol(), SEXI_NO_SYMBOL);
+	expect(sexi::Expr(sexi::id, "add").symbol(), SEXI_NO_SYMBOL);
+
+	expect(symbols.size(), 4u);
+	expect(symbols.str(second[0][2].symbol()), "y");
+	expect(symbols.find("sub"), second[0][0].symbol());
+	expect(symbols.find("nope"), SEXI_NO_SYMBOL);
+
+	// even without copyStrs the string is the table's, not the source's
+	expect(first[0][0].str().data(), symbols.str(0).data());
+	expect(second[0][1].str().data(), symbols.str(0).data());
+
+	// concurrent chunks of a parallel parse agree on every symbol
+	std::string big;
+	for(std::size_t i = 0; big.size() < 2 * 1024 * 1024; i++){
+		big += "(alloc n" + std::to_string(i % 97) + " (load i32 ptr))\n";
+	}
+
+	sexi::SymbolTable bigSymbols;
+	const SexiParseOptions parallelOpts = { .copyStrs = false, .maxDepth = 0, .numThreads = 4, .symbols = bigSymbols.handle(), .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+	auto parallel = sexi::parse(big, parallelOpts);
+	assert(!parallel.hasError());
+
+	for(auto expr : parallel){
+		expect(bigSymbols.str(expr[0].symbol()), expr[0].str());
+		expect(bigSymbols.str(expr[1].symbol()), expr[1].str());
+		expect(expr[2][0].symbol(), bigSymbols.find("load"));
+	}
+
+	expect(bigSymbols.size(), 97u + 4u);
+
+	// the streaming parser and binary decoding intern too
+	std::vector<std::uint32_t> streamed;
+	sexi::Parser parser([&](sexi::ExprRef expr){ streamed.emplace_back(expr[0].symbol()); }, &opts);
+	assert(parser.feed(src));
+	assert(parser.finish());
+	expect(streamed.size(), sexi::parse(src).size());
+	expect(streamed[0], symbols.find("empty"));
+
+	auto decoded = sexi::decodeBinary(sexi::encodeBinary(first.exprs()), &opts);
+	expect(decoded[0][2][0].symbol(), second[0][0].symbol());
+}
+
+// pooled expressions are equal exactly when they are the same pointer
+void testPool(){
+	sexi::ExprPool pool;
+
+	const SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = pool.handle(), .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+	std::string text = "(= %0 (alloc n32)) (alloc n32) (alloc n64) (1.50 1.5 \"n32\" ())";
+	SexiExprConst shared = nullptr;
+
+	{
+		auto first = sexi::parse(text, opts);
+		assert(!first.hasError());
+
+		shared = first[1];
+		expect(SexiExprConst(first[0][2]), shared);
+		expect(SexiExprConst(first[0][2][1]) == SexiExprConst(first[2][0]), false);
+		expect(SexiExprConst(first[0][2][1]), SexiExprConst(first[1][1]));
+		expect(SexiExprConst(first[3][0]), SexiExprConst(first[3][1]));
+		expect(first[3][0].str(), "1.5");
+		expect(SexiExprConst(first[3][2]) == SexiExprConst(first[1][1]), false);
+
+		// strings belong to the pool, not the source
+		auto strBeg = first[1][1].str().data();
+		expect(strBeg >= text.data() && strBeg < text.data() + text.size(), false);
+	}
+
+	// pooled expressions outlive the results they were parsed into
+	auto numExprs = pool.size();
+	auto second = sexi::parse("(alloc n32)", opts);
+	expect(SexiExprConst(second[0]), shared);
+	expect(pool.size(), numExprs);
+	expect(second[0].toStr(), "(alloc n32)");
+
+	// expressions from anywhere else find their pooled twin
+	auto built = ("alloc"_se << "n32");
+	expect(SexiExprConst(pool.intern(built)), shared);
+	expect(SexiExprConst(pool.intern(shared)), shared);
+
+	sexi::Expr elems[] = { sexi::Expr(sexi::id, "alloc"), sexi::Expr(sexi::id, "n32") };
+	SexiExprConst elemPtrs[] = { elems[0], elems[1] };
+	expect(SexiExprConst(pool.list(sexi::ExprSpan(elemPtrs, 2))), shared);
+
+	SexiExprConst nested[] = { shared, elems[0] };
+	auto outer = pool.list(sexi::ExprSpan(nested, 2));
+	expect(SexiExprConst(outer[0]), shared);
+	expect(outer.toStr(), "((alloc n32) alloc)");
+	expect(pool.size(), numExprs + 1);
+
+	// deep trees are interned without recursing
+	std::string deep;
+	for(int i = 0; i < 100000; i++) deep += "(x ";
+	deep += "y";
+	deep.append(100000, ')');
+
+	auto deepTree = sexi::parse(deep);
+	auto deepPooled = pool.intern(deepTree[0]);
+	expect(deepPooled.toStr(), deep);
+	expect(SexiExprConst(sexi::parse(deep, opts)[0]), SexiExprConst(deepPooled));
+
+	// symbols are kept, binary data and the streaming parser share the pool too
+	sexi::SymbolTable symbols;
+	const SexiParseOptions symbolOpts = { .copyStrs = true, .maxDepth = 0, .numThreads = 4, .symbols = symbols.handle(), .pool = pool.handle(), .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+
+	auto interned = sexi::parse("(alloc n32) (alloc n32)", symbolOpts);
+	expect(SexiExprConst(interned[0]), SexiExprConst(interned[1]));
+	expect(interned[0][0].symbol(), symbols.find("alloc"));
+	expect(SexiExprConst(interned[0]) == shared, false);
+
+	auto decoded = sexi::decodeBinary(sexi::encodeBinary(sexi::parse(text).exprs()), &opts);
+	expect(SexiExprConst(decoded[1]), shared);
+
+	std::vector<SexiExprConst> streamed;
+	sexi::Parser parser([&](sexi::ExprRef expr){ streamed.emplace_back(expr); }, &opts);
+	assert(parser.feed(text));
+	assert(parser.finish());
+	expect(streamed.size(), 4u);
+	expect(streamed[1], shared);
+}
+
+// equality and hashing go by value, whatever memory the expressions live in
+void testEquality(std::string_view src){
+	auto lhs = sexi::parse(src), rhs = sexi::parse(src, false);
+
+	expect(lhs.exprs() == rhs.exprs(), true);
+
+	std::vector<sexi::Expr> copies;
+	for(auto expr : lhs) copies.emplace_back(expr);
+
+	expect(rhs.exprs() == copies, true);
+	copies.pop_back();
+	expect(rhs.exprs() != copies, true);
+
+	for(std::size_t i = 0; i < lhs.size(); i++){
+		expect(sexiExprHash(lhs[i]), sexiExprHash(rhs[i]));
+		expect(sexiExprHash(lhs[i]), sexiExprHash(lhs[i]));
+		expect(lhs[i] == copies.front(), i == 0);
+	}
+
+	auto parsed = sexi::parse("(alloc n32) (alloc n64) (1.50 x \"x\" ()) (1.5 x \"x\" ()) (1.5 x x ()) (a) (a b)");
+	auto built = ("alloc"_se << "n32");
+
+	expect(parsed[0] == built, true);
+	expect(built == parsed[1], false);
+	expect(sexiExprHash(parsed[0]), sexiExprHash(built));
+	expect(sexiExprHash(parsed[0]) == sexiExprHash(parsed[1]), false);
+
+	expect(parsed[2] == parsed[3], true);
+	expect(parsed[3] == parsed[4], false);
+	expect(parsed[5] == parsed[6], false);
+	expect(parsed[5][0] == parsed[6][0], true);
+	expect(sexiExprHash(parsed[2]), sexiExprHash(parsed[3]));
+
+	// hashes cached on one side don't make lists compare equal
+	expect(sexiExprHash(parsed[4]) == sexiExprHash(parsed[3]), false);
+	expect(parsed[3] == parsed[4], false);
+
+	// deep trees are compared and hashed without recursing
+	std::string deep;
+	for(int i = 0; i < 100000; i++) deep += "(x ";
+	deep += "y";
+	deep.append(100000, ')');
+
+	auto deepLhs = sexi::parse(deep), deepRhs = sexi::parse(deep);
+	expect(deepLhs[0] == deepRhs[0], true);
+	expect(sexiExprHash(deepLhs[0]), sexiExprHash(deepRhs[0]));
+
+	deep[deep.size() / 2] = 'z';
+	expect(sexi::parse(deep)[0] == deepLhs[0], false);
+
+	// shared trees can be hashed from several threads at once
+	std::vector<std::uint64_t> hashes(4);
+	std::vector<std::thread> threads;
+	for(auto &hash : hashes){
+		threads.emplace_back([&hash, &deepRhs]{ hash = sexiExprHash(deepRhs[0][1][1]); });
+	}
+
+	for(auto &thread : threads) thread.join();
+	for(auto hash : hashes) expect(hash, sexiExprHash(deepLhs[0][1][1]));
+
+	std::unordered_map<sexi::Expr, int> counts;
+	for(auto expr : parsed) ++counts[expr[0]];
+
+	expect(counts.size(), 3u);
+	expect(counts[sexi::Expr(sexi::id, "alloc")], 2);
+	expect(counts[sexi::Expr(sexi::num, 1.5)], 3);
+
+	std::unordered_set<sexi::ExprRef> unique;
+	for(auto expr : lhs) unique.insert(expr);
+	for(auto expr : rhs) unique.insert(expr);
+	expect(unique.size(), lhs.size());
+}
+
+// accessors hand out the parsed expressions themselves, copies are only made on request
+void testExprRef(){
+	auto result = sexi::parse("(a (b c) \"d\") (1)");
+
+	SexiExprConst first = result.exprs()[0];
+	expect(static_cast<SexiExprConst>(result[0]), first);
+	expect(static_cast<SexiExprConst>(result[0][1][0]), sexiExprAt(sexiExprAt(first, 1), 0));
+
+	std::size_t i = 0;
+	for(auto elem : result[0]){
+		expect(static_cast<SexiExprConst>(elem), sexiExprAt(first, i++));
+	}
+
+	expect(result[0][2].str(), "\"d\"");
+
+	sexi::Expr owned = result[0][1];
+	assert(static_cast<SexiExprConst>(owned) != static_cast<SexiExprConst>(result[0][1]));
+	expect(owned.toStr(), "(b c)");
+	expect(owned[1].str(), "c");
+}
+
+// writing never touches the expressions, so it works from any thread and at any depth
+void testWriter(){
+	auto result = sexi::parse("(a (b \"c d\") () 1.50)");
+	SexiExprConst expr = result.exprs()[0];
+
+	const std::string_view text = "(a (b \"c d\") () 1.5)";
+
+	expect(sexiExprWrite(expr, nullptr, 0), text.size());
+
+	char buf[8];
+	expect(sexiExprWrite(expr, buf, sizeof(buf)), text.size());
+	expect(std::string_view(buf), text.substr(0, sizeof(buf) - 1));
+
+	std::string sunk;
+	assert(sexiExprWriteSink(expr, [](void *user, SexiStr str){
+		static_cast<std::string*>(user)->append(str.ptr, str.len);
+		return true;
+	}, &sunk));
+	expect(sunk, text);
+
+	assert(!sexiExprWriteSink(expr, [](void*, SexiStr){ return false; }, nullptr));
+
+	auto file = std::tmpfile();
+	assert(file);
+	assert(sexiExprWriteFd(expr, fileno(file)));
+
+	std::string fromFd(text.size() + 1, '\0');
+	std::rewind(file);
+	expect(std::fread(fromFd.data(), 1, fromFd.size(), file), text.size());
+	fromFd.resize(text.size());
+	expect(fromFd, text);
+	std::fclose(file);
+
+	// lists have no text to hand out, only the writers give it
+	auto listStr = sexiExprToStr(expr);
+	expect(listStr.len, 0u);
+	assert(!listStr.ptr);
+
+	// nesting far deeper than the call stack could take
+	constexpr std::size_t depth = 100000;
+	std::string deep(depth, '(');
+	deep += 'x';
+	deep.append(depth, ')');
+
+	auto deepResult = sexi::parse(deep);
+	assert(!deepResult.hasError());
+
+	std::string deepText(deep.size() + 1, '\0');
+	expect(sexiExprWrite(deepResult.exprs()[0], deepText.data(), deepText.size()), deep.size());
+	deepText.resize(deep.size());
+	expect(deepText, deep);
+}
+
+// decoding the encoding of a parse gives back the same expressions
+void testBinary(std::string_view src){
+	auto parsed = sexi::parse(src);
+	auto data = sexi::encodeBinary(parsed.exprs());
+
+	auto decoded = sexi::decodeBinary(data);
+	assert(!decoded.hasError());
+	expect(decoded.size(), parsed.size());
+
+	for(std::size_t i = 0; i < parsed.size(); i++){
+		expect(decoded[i].toStr(), parsed[i].toStr());
+	}
+
+	// numbers are stored by value, unless their text isn't what the value prints as
+	auto nums = sexi::parse("(a 0 7 12345 007 1.50 18446744073709551615 99999999999999999999 \"s\" () 1e3 0.1)");
+	auto numData = sexi::encodeBinary(nums.exprs());
+
+	const SexiParseOptions zeroCopy = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+	auto numsDecoded = sexi::decodeBinary(numData, &zeroCopy);
+	assert(!numsDecoded.hasError());
+	expect(numsDecoded[0].toStr(), nums[0].toStr());
+
+	auto inData = [&](std::string_view str){ return str.data() >= numData.data() && str.data() < numData.data() + numData.size(); };
+	assert(inData(numsDecoded[0][0].str()));
+	assert(!inData(numsDecoded[0][3].str()));
+	assert(inData(numsDecoded[0][4].str()));
+	assert(!inData(numsDecoded[0][5].str()));
+	assert(inData(numsDecoded[0][10].str()));
+	assert(!inData(numsDecoded[0][11].str()));
+
+	double d = 0;
+	expect(numsDecoded[0][11].asDouble(d), SEXI_NUM_OK);
+	expect(d, 0.1);
+
+	// negative integers and doubles round-trip by value
+	SexiExprConst signedNums[] = { sexiCreateInt(-5), sexiCreateInt(INT64_MIN), sexiCreateInt(INT64_MAX), sexiCreateUint(UINT64_MAX), sexiCreateDouble(-2.75), sexiCreateDouble(1e300), sexiCreateDouble(5e-324) };
+	auto signedDecoded = sexi::decodeBinary(sexi::encodeBinary(sexi::ExprSpan(signedNums, std::size(signedNums))));
+	assert(!signedDecoded.hasError());
+	expect(signedDecoded.size(), std::size(signedNums));
+
+	std::int64_t i = 0;
+	std::uint64_t u = 0;
+	expect(signedDecoded[0].str(), "-5");
+	expect(signedDecoded[0].asInt(i), SEXI_NUM_OK);
+	expect(i, -5);
+	expect(signedDecoded[1].asInt(i), SEXI_NUM_OK);
+	expect(i, INT64_MIN);
+	expect(signedDecoded[2].asInt(i), SEXI_NUM_OK);
+	expect(i, INT64_MAX);
+	expect(signedDecoded[3].asUint(u), SEXI_NUM_OK);
+	expect(u, UINT64_MAX);
+
+	for(std::size_t j = 4; j < std::size(signedNums); j++){
+		double expected = 0;
+		sexiExprAsDouble(signedNums[j], &expected);
+		expect(signedDecoded[j].asDouble(d), SEXI_NUM_OK);
+		expect(d, expected);
+		expect(signedDecoded[j].toStr(), sexi::ExprRef(signedNums[j]).toStr());
+	}
+
+	// the value of a negative integer is the whole payload, not its text
+	expect(sexi::encodeBinary(sexi::ExprSpan(signedNums, 1)), std::string("SXB\x01\x4e", 5));
+
+	for(auto num : signedNums) sexiDestroyExpr(const_cast<SexiExpr>(num));
+
+	// every truncation within an expression is reported, never read past
+	expect(sexi::decodeBinary(std::string(numData, 0, 4)).size(), 0u);
+
+	for(std::size_t len = 0; len < numData.size(); len++){
+		if(len == 4) continue;
+
+		auto truncated = sexi::decodeBinary(std::string(numData, 0, len));
+		assert(truncated.hasError());
+		expect(truncated.error(), len < 4 ? "invalid binary header" : "unexpected end of binary data");
+	}
+
+	auto invalidTag = sexi::decodeBinary(std::string("SXB\x01\x0f", 5));
+	expect(invalidTag.error(), "invalid tag in binary data");
+
+	const SexiParseOptions shallow = { .copyStrs = true, .maxDepth = 2, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+	auto deep = sexi::parse("(a (b (c)))");
+	auto tooDeep = sexi::decodeBinary(sexi::encodeBinary(deep.exprs()), &shallow);
+	expect(tooDeep.error(), "maximum nesting depth exceeded");
+}
+
+// every allocation goes back to the allocator it came from
+struct CountingAllocator{
+	std::atomic<std::size_t> numLive = 0, numTotal = 0; // parallel parses allocate from several threads
+
+	SexiAllocator alloc = {
+		.alloc = [](void *self, size_t size) -> void*{
+			auto ret = std::malloc(size);
+			if(ret) ++static_cast<CountingAllocator*>(self)->numLive, ++static_cast<CountingAllocator*>(self)->numTotal;
+			return ret;
+		},
+		.realloc = [](void *self, void *ptr, size_t size) -> void*{
+			auto ret = std::realloc(ptr, size);
+			if(ret && !ptr) ++static_cast<CountingAllocator*>(self)->numLive, ++static_cast<CountingAllocator*>(self)->numTotal;
+			return ret;
+		},
+		.free = [](void *self, void *ptr){
+			--static_cast<CountingAllocator*>(self)->numLive;
+			std::free(ptr);
+		},
+		.userdata = this,
+	};
+
+	CountingAllocator() = default;
+	CountingAllocator(const CountingAllocator&) = delete;
+};
+
+void testAllocator(std::string_view src){
+	CountingAllocator counter;
+
+	{
+		const SexiParseOptions opts = { .copyStrs = true, .maxDepth = 0, .numThreads = 4, .symbols = nullptr, .pool = nullptr, .allocator = &counter.alloc, .locations = false, .recover = false, .lazyDepth = 0 };
+		auto parsed = sexi::parse(src, opts);
+		assert(!parsed.hasError());
+		expect(parsed.size(), sexi::parse(src).size());
+		assert(counter.numLive > 0);
+
+		std::string big;
+		for(int i = 0; i < 50000; i++) big += "(item " + std::to_string(i) + " \"text\")\n";
+
+		auto parallel = sexi::parse(big, opts);
+		expect(parallel.size(), 50000u);
+		expect(parallel[49999].toStr(), "(item 49999 \"text\")");
+
+		auto tape = sexi::parseTape(src, &opts);
+		assert(!tape.hasError());
+
+		auto decoded = sexi::decodeBinary(sexi::encodeBinary(parsed.exprs()), &opts);
+		expect(decoded.size(), parsed.size());
+
+		std::size_t numStreamed = 0;
+		sexi::Parser parser([&](sexi::ExprRef){ ++numStreamed; }, &opts);
+		assert(parser.feed(src));
+		assert(parser.finish());
+		expect(numStreamed, parsed.size());
+	}
+
+	expect(counter.numLive, 0u);
+
+	// expressions built by hand keep their allocator through cloning and appending
+	std::size_t before = counter.numTotal;
+
+	SexiExprConst elems[] = { sexiCreateIdEx({ .len = 3, .ptr = "add" }, &counter.alloc), sexiCreateIntEx(-12, &counter.alloc), sexiCreateDoubleEx(0.5, &counter.alloc) };
+	auto list = sexiCreateListEx(3, elems, &counter.alloc);
+	for(auto elem : elems) sexiDestroyExpr(const_cast<SexiExpr>(elem));
+
+	auto grown = sexiCreateEmptyEx(&counter.alloc);
+	for(int i = 0; i < 20; i++) assert(sexiExprAppend(grown, sexiCreateUintEx(i, &counter.alloc)));
+
+	auto clone = sexiCloneExprEx(list, &counter.alloc);
+	expect(sexi::ExprRef(clone).toStr(), "(add -12 0.5)");
+	expect(sexiExprLength(grown), 20u);
+	assert(counter.numTotal > before);
+
+	sexiDestroyExpr(list);
+	sexiDestroyExpr(grown);
+	sexiDestroyExpr(clone);
+	expect(counter.numLive, 0u);
+
+	// the default allocator covers everything not given one, and only new memory
+	auto old = sexi::parse(src);
+
+	sexiSetDefaultAllocator(&counter.alloc);
+	expect(sexiGetDefaultAllocator(), &counter.alloc);
+
+	before = counter.numTotal;
+	{
+		auto parsed = sexi::parse(src);
+		auto built = ("f"_se << 1 << "x");
+		sexi::SymbolTable symbols;
+		sexi::ExprPool pool;
+		pool.intern(built);
+		assert(counter.numTotal > before);
+	}
+
+	sexiSetDefaultAllocator(nullptr);
+	assert(sexiGetDefaultAllocator() != &counter.alloc);
+
+	expect(old.size(), sexi::parse(src).size());
+	expect(counter.numLive, 0u);
+}
+
+// fails every allocation once its budget is spent
+struct BudgetAllocator{
+	std::atomic<std::size_t> budget = 0;
+
+	SexiAllocator alloc = {
+		.alloc = [](void *self, size_t size) -> void*{
+			return static_cast<BudgetAllocator*>(self)->spend() ? std::malloc(size) : nullptr;
+		},
+		.realloc = [](void *self, void *ptr, size_t size) -> void*{
+			return static_cast<BudgetAllocator*>(self)->spend() ? std::realloc(ptr, size) : nullptr;
+		},
+		.free = [](void*, void *ptr){ std::free(ptr); },
+		.userdata = this,
+	};
+
+	bool spend() noexcept{
+		auto left = budget.load();
+		while(left && !budget.compare_exchange_weak(left, left - 1)){}
+		return left != 0;
+	}
+
+	BudgetAllocator() = default;
+	BudgetAllocator(const BudgetAllocator&) = delete;
+};
+
+// running out of memory anywhere is reported as an error, never thrown through the C API
+void testAllocFailure(std::string_view src){
+	BudgetAllocator budget;
+
+	std::string big;
+	for(int i = 0; big.size() < 256 * 1024; i++){
+		big += "(form " + std::to_string(i) + " (args \"s\" (x 1.5)))\n";
+	}
+
+	auto expectFailures = [&](std::string_view text, const SexiParseOptions &opts){
+		auto expected = sexi::parse(text);
+		bool succeeded = false;
+
+		for(std::size_t n = 0; !succeeded && n < 10000; n++){
+			budget.budget = n;
+
+			auto res = sexiParseEx(text.size(), text.data(), &opts);
+			if(!res) continue;
+
+			if(sexiParseResultHasError(res)){
+				auto err = sexiParseResultError(res);
+				assert(std::string_view(err.ptr, err.len).find("failed to allocate") == 0);
+			}
+			else{
+				budget.budget = SIZE_MAX;
+				expect(sexiParseResultNumExprs(res), expected.size());
+				expect(sexi::ExprRef(sexiParseResultExprs(res)[expected.size() - 1]).toStr(), expected[expected.size() - 1].toStr());
+				succeeded = true;
+			}
+
+			sexiDestroyParseResult(res);
+		}
+
+		assert(succeeded);
+	};
+
+	SexiParseOptions opts = { .copyStrs = true, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = &budget.alloc, .locations = false, .recover = false, .lazyDepth = 0 };
+	expectFailures(src, opts);
+
+	opts.locations = true;
+	opts.recover = true;
+	expectFailures(src, opts);
+
+	opts.locations = false;
+	opts.recover = false;
+	opts.numThreads = 4;
+	expectFailures(big, opts);
+
+	opts.numThreads = 0;
+	for(std::size_t n = 0; n < 100; n++){
+		budget.budget = n;
+
+		auto tape = sexiParseTape(src.size(), src.data(), &opts);
+		if(!tape) continue;
+
+		if(sexiTapeHasError(tape)){
+			auto err = sexiTapeError(tape);
+			assert(std::string_view(err.ptr, err.len).find("failed to allocate") == 0);
+		}
+
+		sexiDestroyTape(tape);
+	}
+
+	auto data = sexi::encodeBinary(sexi::parse(src).exprs());
+	for(std::size_t n = 0; n < 100; n++){
+		budget.budget = n;
+
+		auto res = sexiDecodeBinary(data.size(), data.data(), &opts);
+		if(!res) continue;
+
+		if(sexiParseResultHasError(res)){
+			auto err = sexiParseResultError(res);
+			assert(std::string_view(err.ptr, err.len).find("failed to allocate") == 0);
+		}
+
+		sexiDestroyParseResult(res);
+	}
+
+	for(std::size_t n = 0; n < 100; n++){
+		budget.budget = n;
+
+		auto parser = sexiParserCreate(&opts, [](void*, SexiExprConst){}, nullptr);
+		if(!parser) continue;
+
+		if(!sexiParserFeed(parser, src.size(), src.data()) || !sexiParserFinish(parser)){
+			auto err = sexiParserError(parser);
+			assert(std::string_view(err.ptr, err.len).find("failed to allocate") == 0);
+		}
+
+		sexiParserDestroy(parser);
+	}
+
+	// a lazy list there's no memory to build stays unbuilt until a later read manages it
+	opts.lazyDepth = 1;
+	budget.budget = SIZE_MAX;
+
+	auto lazy = sexiParseEx(17, "(a (b (c d)) (e))", &opts);
+	assert(!sexiParseResultHasError(lazy));
+	auto lazyList = sexiParseResultExprs(lazy)[0];
+
+	budget.budget = 0;
+	expect(sexiExprLength(lazyList), 0u);
+	assert(!sexiExprAt(lazyList, 0));
+	expect(sexiExprHash(lazyList), 0u);
+	assert(sexiParseResultHasError(lazy));
+	auto lazyErr = sexiParseResultError(lazy);
+	expect(std::string_view(lazyErr.ptr, lazyErr.len), "failed to allocate lazy list");
+
+	budget.budget = SIZE_MAX;
+	expect(sexiExprLength(lazyList), 3u);
+	expect(sexi::ExprRef(lazyList).toStr(), "(a (b (c d)) (e))");
+	sexiDestroyParseResult(lazy);
+	opts.lazyDepth = 0;
+
+	// hand-built lists that can't be cloned whole are given back entirely
+	SexiExprConst elems[] = { sexiCreateInt(1), sexiCreateId({ .len = 1, .ptr = "x" }), sexiCreateStr({ .len = 1, .ptr = "s" }) };
+	for(std::size_t n = 0; n < 8; n++){
+		budget.budget = n;
+
+		auto list = sexiCreateListEx(std::size(elems), elems, &budget.alloc);
+		if(list){
+			expect(sexi::ExprRef(list).toStr(), "(1 x \"s\")");
+			sexiDestroyExpr(list);
+		}
+	}
+
+	for(auto elem : elems) sexiDestroyExpr(const_cast<SexiExpr>(elem));
+}
+
+// spans and error positions point back into the source
+void testLocations(std::string_view src){
+	const SexiParseOptions opts = { .copyStrs = true, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = true, .recover = false, .lazyDepth = 0 };
+
+	auto checkSpans = [](std::string_view text, const sexi::ParseResult &res){
+		std::size_t numChecked = 0;
+
+		std::vector<sexi::ExprRef> pending;
+		for(auto &&expr : res) pending.emplace_back(expr);
+
+		while(!pending.empty()){
+			auto expr = pending.back();
+			pending.pop_back();
+
+			SexiSourceSpan span;
+			assert(res.span(expr, span));
+
+			auto spanText = text.substr(span.offset, span.len);
+			if(expr.isList() || expr.isEmpty()){
+				expect(spanText.front(), '(');
+				expect(spanText.back(), ')');
+				expect(sexi::parse(spanText)[0].toStr(), expr.toStr());
+			}
+			else if(!expr.isNum()){
+				expect(spanText, expr.str());
+			}
+
+			if(expr.isList()){
+				for(std::size_t i = 0; i < expr.length(); i++) pending.emplace_back(expr[i]);
+			}
+
+			++numChecked;
+		}
+
+		return numChecked;
+	};
+
+	auto parsed = sexi::parse(src, opts);
+	assert(!parsed.hasError());
+	assert(checkSpans(src, parsed) > parsed.size());
+
+	auto text = std::string("(first  (a \"b c\" 007 ()))\n\t(second)");
+	auto small = sexi::parse(text, opts);
+
+	SexiSourceSpan span;
+	assert(small.span(small[0][1][2], span));
+	expect(span.offset, 17u);
+	expect(span.len, 3u);
+	assert(small.span(small[0][1][3], span));
+	expect(text.substr(span.offset, span.len), "()");
+	assert(small.span(small[1], span));
+	expect(text.substr(span.offset), "(second)");
+
+	// nothing is recorded unless asked for, and only expressions of the result have spans
+	assert(!sexi::parse(text).span(small[0], span));
+	assert(!small.span(sexi::parse(text)[0], span));
+
+	// the first lookups may come from several threads at once
+	std::string big;
+	for(int i = 0; i < 50000; i++) big += "(item " + std::to_string(i) + " (\"text\" x" + std::to_string(i % 7) + "))\n";
+
+	const SexiParseOptions parallelOpts = { .copyStrs = false, .maxDepth = 0, .numThreads = 4, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = true, .recover = false, .lazyDepth = 0 };
+	auto bigParsed = sexi::parse(big, parallelOpts);
+	assert(!bigParsed.hasError());
+
+	std::vector<std::thread> threads;
+	for(int t = 0; t < 4; t++){
+		threads.emplace_back([&, t]{
+			for(std::size_t i = std::size_t(t); i < bigParsed.size(); i += 997){
+				SexiSourceSpan itemSpan, nameSpan;
+				assert(bigParsed.span(bigParsed[i], itemSpan));
+				assert(bigParsed.span(bigParsed[i][2][1], nameSpan));
+
+				auto line = "(item " + std::to_string(i) + " (\"text\" x" + std::to_string(i % 7) + "))";
+				expect(big.substr(itemSpan.offset, itemSpan.len), line);
+				expect(big.substr(nameSpan.offset, nameSpan.len), "x" + std::to_string(i % 7));
+			}
+		});
+	}
+
+	for(auto &&thread : threads) thread.join();
+
+	// errors know where they happened, whether or not spans are recorded
+	SexiSourcePos pos;
+	assert(!parsed.errorPos(pos));
+
+	auto bad = sexi::parse("(a b)\n(c\n  d 1.2.3)");
+	expect(bad.error(), "multiple decimal points in number");
+	assert(bad.errorPos(pos));
+	expect(pos.offset, 16u);
+	expect(pos.line, 3u);
+	expect(pos.column, 8u);
+
+	auto unclosed = sexi::parse("(a\n(b)", opts);
+	assert(unclosed.errorPos(pos));
+	expect(pos.offset, 6u);
+	expect(pos.line, 2u);
+	expect(pos.column, 4u);
+
+	auto badBig = big + "\n  (broken 1.2.3)";
+	auto badParsed = sexi::parse(badBig, parallelOpts);
+	expect(badParsed.error(), "multiple decimal points in number");
+	assert(badParsed.errorPos(pos));
+	expect(pos.offset, badBig.size() - 3);
+	expect(pos.line, 50002u);
+	expect(pos.column, 14u);
+	expect(badParsed.size(), 50000u);
+
+	SexiSourceSpan lastSpan;
+	assert(badParsed.span(badParsed[49999], lastSpan));
+	expect(lastSpan.offset + lastSpan.len, big.size() - 1);
+}
+
+// a recovering parse skips bad expressions and keeps going
+void testRecovery(){
+	const SexiParseOptions opts = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = true, .recover = true, .lazyDepth = 0 };
+
+	std::string text = "(a 1)\n(b 1.2.3 (c))\nstray \"(no)\" (d \"x\")\n(e \x01 (f))\n(g)\n(h";
+
+	auto stopped = sexi::parse(text);
+	expect(stopped.size(), 1u);
+	expect(stopped.numErrors(), 1u);
+	expect(stopped.errorInfo(0).pos.line, 2u);
+
+	auto recovered = sexi::parse(text, opts);
+	assert(recovered.hasError());
+	expect(recovered.error(), "multiple decimal points in number");
+
+	expect(recovered.size(), 3u);
+	expect(recovered[0].toStr(), "(a 1)");
+	expect(recovered[1].toStr(), "(d \"x\")");
+	expect(recovered[2].toStr(), "(g)");
+
+	const std::pair<std::string_view, std::size_t> expected[] = {
+		{ "multiple decimal points in number", 2 },
+		{ "unexpected token at top level", 3 },
+		{ "unexpected token in list", 4 },
+		{ "unexpected end of source in id", 6 },
+	};
+
+	expect(recovered.numErrors(), std::size(expected));
+
+	for(std::size_t i = 0; i < std::size(expected); i++){
+		auto &info = recovered.errorInfo(i);
+		expect(std::string_view(info.msg.ptr, info.msg.len), expected[i].first);
+		expect(info.pos.line, expected[i].second);
+	}
+
+	expect(recovered.errorInfo(1).pos.column, 1u);
+	expect(recovered.errorInfo(2).pos.offset, text.find('\x01'));
+	expect(recovered.errorInfo(3).pos.offset, text.size());
+
+	SexiSourcePos pos;
+	assert(recovered.errorPos(pos));
+	expect(pos.offset, recovered.errorInfo(0).pos.offset);
+
+	// spans of the skipped expressions don't linger
+	SexiSourceSpan span;
+	assert(recovered.span(recovered[1][1], span));
+	expect(text.substr(span.offset, span.len), "\"x\"");
+	assert(recovered.span(recovered[2], span));
+	expect(text.substr(span.offset, span.len), "(g)");
+
+	auto clean = sexi::parse("(a) (b)", opts);
+	assert(!clean.hasError());
+	expect(clean.numErrors(), 0u);
+
+	// chunks of a parallel parse recover on their own and are merged in order
+	std::string big;
+	for(int i = 0; i < 60000; i++){
+		big += i % 1000 == 7 ? "(item " + std::to_string(i) + " 1.2.3)\n" : "(item " + std::to_string(i) + " (x))\n";
+	}
+
+	auto serial = sexi::parse(big, opts);
+
+	const SexiParseOptions parallelOpts = { .copyStrs = false, .maxDepth = 0, .numThreads = 4, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = true, .recover = true, .lazyDepth = 0 };
+	auto parallel = sexi::parse(big, parallelOpts);
+
+	expect(serial.size(), 59940u);
+	expect(parallel.size(), serial.size());
+	expect(parallel.numErrors(), 60u);
+
+	for(std::size_t i = 0; i < parallel.numErrors(); i++){
+		expect(parallel.errorInfo(i).pos.offset, serial.errorInfo(i).pos.offset);
+		expect(parallel.errorInfo(i).pos.line, i * 1000 + 8);
+		expect(parallel.errorInfo(i).pos.column, serial.errorInfo(i).pos.column);
+	}
+
+	assert(parallel.span(parallel[59939], span));
+	expect(big.substr(span.offset, span.len), "(item 59999 (x))");
+
+	// pooled expressions come through too
+	sexi::ExprPool pool;
+	const SexiParseOptions poolOpts = { .copyStrs = false, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = pool.handle(), .allocator = nullptr, .locations = false, .recover = true, .lazyDepth = 0 };
+	auto pooled = sexi::parse("(a (b)) (a (b 1.2.3)) (a (b))", poolOpts);
+	expect(pooled.size(), 2u);
+	expect(SexiExprConst(pooled[0]), SexiExprConst(pooled[1]));
+}
+
+void testLazy(std::string_view src){
+	SexiParseOptions opts = { .copyStrs = true, .maxDepth = 0, .numThreads = 0, .symbols = nullptr, .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 1 };
+
+	auto eager = sexi::parse(src);
+
+	for(std::size_t depth = 1; depth <= 3; depth++){
+		opts.lazyDepth = depth;
+
+		auto lazy = sexi::parse(src, opts);
+		assert(!lazy.hasError());
+		expect(lazy.size(), eager.size());
+
+		for(std::size_t i = 0; i < lazy.size(); i++){
+			expect(sexiExprHash(lazy[i]), sexiExprHash(eager[i]));
+			expect(lazy[i] == eager[i], true);
+			expect(lazy[i].toStr(), eager[i].toStr());
+		}
+	}
+
+	// only the lists read are built, from a copy of their text unless the source outlives the result
+	std::string text = "(a (b (c d)) () (e))";
+	opts.lazyDepth = 2;
+
+	auto selective = sexi::parse(text, opts);
+	text.assign(text.size(), ' ');
+
+	expect(selective[0].length(), 4u);
+	expect(selective[0][0].str(), "a");
+	assert(selective[0][2].isEmpty());
+	expect(selective[0][1].length(), 2u);
+	expect(selective[0][1][1].toStr(), "(c d)");
+	expect(selective[0].toStr(), "(a (b (c d)) () (e))");
+
+	// the whole source is still checked
+	opts.lazyDepth = 1;
+
+	auto bad = sexi::parse("(a) (b (c 1.2.3))", opts);
+	assert(bad.hasError());
+	expect(bad.error(), "multiple decimal points in number");
+	expect(bad.size(), 1u);
+
+	opts.recover = true;
+	auto recovered = sexi::parse("(a (1.2.3)) (b (c))", opts);
+	expect(recovered.numErrors(), 1u);
+	expect(recovered.size(), 1u);
+	expect(recovered[0].toStr(), "(b (c))");
+	opts.recover = false;
+
+	// unbuilt lists have spans, what's in them once built doesn't
+	opts.locations = true;
+	opts.lazyDepth = 2;
+
+	auto located = sexi::parse("(a (b c))", opts);
+	SexiSourceSpan span;
+	assert(located.span(located[0][1], span));
+	expect(span.offset, 3u);
+	expect(span.len, 5u);
+	assert(!located.span(located[0][1][0], span));
+	opts.locations = false;
+
+	// the first reads of a list can come from several threads at once
+	std::string big;
+	for(int i = 0; i < 20000; i++){
+		big += "(form " + std::to_string(i) + " (args (x " + std::to_string(i * 0.5) + ") \"s\") (body (y) (z)))\n";
+	}
+
+	auto bigEager = sexi::parse(big);
+
+	for(auto numThreads : { 0, 4 }){
+		opts.lazyDepth = 1;
+		opts.numThreads = numThreads;
+
+		auto bigLazy = sexi::parse(big, opts);
+		assert(!bigLazy.hasError());
+		expect(bigLazy.size(), bigEager.size());
+
+		std::vector<std::thread> threads;
+		std::vector<int> mismatches(4);
+
+		for(std::size_t t = 0; t < mismatches.size(); t++){
+			threads.emplace_back([&, t]{
+				for(std::size_t i = 0; i < bigLazy.size(); i++){
+					auto idx = (i + t * 997) % bigLazy.size();
+					if(bigLazy[idx][2][1].toStr() != bigEager[idx][2][1].toStr()) ++mismatches[t];
+				}
+			});
+		}
+
+		for(auto &thread : threads) thread.join();
+		for(auto count : mismatches) expect(count, 0);
+
+		for(std::size_t i = 0; i < bigLazy.size(); i++){
+			expect(bigLazy[i] == bigEager[i], true);
+		}
+	}
+}
+
 int main(int argc, char *argv[]){
 	(void)argc;
 	(void)argv;
@@ -188,7 +1849,18 @@ int main(int argc, char *argv[]){
 		while(std::getline(file, tmp)) src += tmp + '\n';
 	}
 
-	auto result = sexi::parse(src);
+	// test names are interned first, so their symbols are known before parsing
+	enum TestSymbol: std::uint32_t{
+		TEST_EMPTY, TEST_ARRAY, TEST_LIST, TEST_TEXT, TEST_MATH, TEST_SET,
+	};
+
+	sexi::SymbolTable symbols;
+	for(auto name : { "empty", "array", "list", "text", "math", "set" }){
+		symbols.intern(name);
+	}
+
+	const SexiParseOptions opts = { .copyStrs = true, .maxDepth = 0, .numThreads = 0, .symbols = symbols.handle(), .pool = nullptr, .allocator = nullptr, .locations = false, .recover = false, .lazyDepth = 0 };
+	auto result = sexi::parse(src, opts);
 
 	if(result.hasError()){
 		std::cerr << "Error parsing test file: " << result.error() << '\n';
@@ -204,19 +1876,19 @@ int main(int argc, char *argv[]){
 
 		assert(head.isId());
 
-		auto testId = head.toStr();
+		void(*testFn)(sexi::ExprRef) = nullptr;
 
-		void(*testFn)(const sexi::Expr&) = nullptr;
+		switch(head.symbol()){
+			case TEST_EMPTY: testFn = testEmpty; break;
+			case TEST_ARRAY: testFn = testArray; break;
+			case TEST_LIST: testFn = testList; break;
+			case TEST_TEXT: testFn = testText; break;
+			case TEST_MATH: testFn = testMath; break;
+			case TEST_SET: testFn = testSet; break;
 
-		if(testId == "empty") testFn = testEmpty;
-		else if(testId == "array") testFn = testArray;
-		else if(testId == "list") testFn = testList;
-		else if(testId == "text") testFn = testText;
-		else if(testId == "math") testFn = testMath;
-		else if(testId == "set") testFn = testSet;
-		else{
-			std::cerr << "unexpected test type '" << testId << "'\n";
-			std::exit(EXIT_FAILURE);
+			default:
+				std::cerr << "unexpected test type '" << head.str() << "'\n";
+				std::exit(EXIT_FAILURE);
 		}
 
 		auto testExpr = expr[1];
@@ -227,6 +1899,41 @@ int main(int argc, char *argv[]){
 	}
 
 	testOperators();
+	testListBuilder();
+
+	testZeroCopy(src);
+
+	testDepthLimit();
+
+	testScanKernels();
+	testBlockBoundaries();
+
+	testLocale();
+
+	testParseFile(src);
+
+	testStreaming(src);
+
+	testEvents(src);
+
+	testParallel();
+
+	testTape(src);
+
+	testExprRef();
+	testWriter();
+	testBinary(src);
+	testSnapshot(src);
+	testNumbers();
+	testNumberFormat();
+	testSymbols(src);
+	testPool();
+	testEquality(src);
+	testAllocator(src);
+	testAllocFailure(src);
+	testLocations(src);
+	testRecovery();
+	testLazy(src);
 
 	std::cout << "All tests passed\n";
 